@@ -31,8 +31,9 @@ namespace std
 
 namespace AlienAlgebra
 {
-    // most of these properties are just made up
-    static HashSet<OperationProperty> allProperties =
+    // most of these properties are just made up;
+    // this is a vector, not a set, so that picking from it is reproducible
+    static const Vector<OperationProperty> allProperties =
     {
         // the first level is intended to be introductory
         {"$x . $x => $x", {0}}, // idempotence
@@ -98,6 +99,7 @@ namespace AlienAlgebra
 
         // warning: when adding new properties make sure properties make sure
         // they will not cause an infinite loop of rewriting, e.g. "x . y => (y . x) . x",
-        // or "$x . ($y . $z) => ($x . $y) . ($y . $x)"
+        // or "$x . ($y . $z) => ($x . $y) . ($y . $x)"; the compatibility tool
+        // (PropertyCompatibility.cpp) checks that
     };
 } // namespace AlienAlgebra
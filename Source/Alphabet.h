@@ -0,0 +1,238 @@
+#pragma once
+
+#include "Common.h"
+#include "EGraph.h"
+
+#include <bitset>
+#include <cstdint>
+
+// All the symbols the generator can pick from, and the interner
+// that gives each of them a small id: terms come first, then operations,
+// in the order they are listed here; the generator and the hints extractor
+// work on these ids and only turn them back into strings for display
+
+// a strong type, so that it's never confused with class ids or indices
+enum class SymbolId : uint8_t {};
+
+// a set of symbol ids as a fixed-width bitmask: both alphabets together
+// are less than 64 symbols, so set operations are a couple of instructions,
+// and counting the symbols missing in another set is an and-not plus a popcount
+struct SymbolSet final
+{
+    static constexpr auto maxSymbols = 64;
+
+    void insert(SymbolId id)
+    {
+        assert(int(id) < maxSymbols);
+        this->bits.set(size_t(id));
+    }
+
+    bool contains(SymbolId id) const
+    {
+        return this->bits.test(size_t(id));
+    }
+
+    bool empty() const noexcept
+    {
+        return this->bits.none();
+    }
+
+    int size() const noexcept
+    {
+        return int(this->bits.count());
+    }
+
+    // the number of symbols in this set which are not in the other one
+    int countExcept(const SymbolSet &other) const noexcept
+    {
+        return int((this->bits & ~other.bits).count());
+    }
+
+    Vector<SymbolId> toVector() const
+    {
+        Vector<SymbolId> result;
+        for (int i = 0; i < maxSymbols; ++i)
+        {
+            if (this->bits.test(i))
+            {
+                result.push_back(SymbolId(i));
+            }
+        }
+        return result;
+    }
+
+    SymbolSet &operator|=(const SymbolSet &other) noexcept
+    {
+        this->bits |= other.bits;
+        return *this;
+    }
+
+    friend SymbolSet operator-(const SymbolSet &l, const SymbolSet &r) noexcept
+    {
+        SymbolSet result;
+        result.bits = l.bits & ~r.bits;
+        return result;
+    }
+
+    friend bool operator==(const SymbolSet &l, const SymbolSet &r) noexcept
+    {
+        return l.bits == r.bits;
+    }
+
+    std::bitset<maxSymbols> bits;
+};
+
+namespace Alphabet
+{
+#if WEB_CLIENT
+
+    static const Vector<e::Symbol> allTerms = {
+        "a", "d", "e", "f", "n", "o", "q", "s", "u", "v", "w", "x", "y", "z",
+        "0", "1", "3", "4", "5", "7", "9"
+    };
+
+    static const Vector<Vector<e::Symbol>> allOperations = {
+        {"\xe2\x87\x8c", "\xe2\xa5\xa2", "\xe2\xa5\xa4"}, // ⇌ ⥢ ⥤
+        {"\xe2\xa5\x83", "\xe2\xa5\x84"}, // ⥃ ⥄
+        {"\xe2\xa4\x9d", "\xe2\xa4\x9e", "\xe2\x87\x9c", "\xe2\x87\x9d"}, // ⤝ ⤞ ⇜ ⇝
+        {"\xe2\x86\xab", "\xe2\x86\xac", "\xe2\x86\x9c", "\xe2\x86\x9d"}, // ↫ ↬ ↜ ↝
+        {"\xe2\xac\xb8", "\xe2\xa4\x91"}, // ⬸ ⤑
+        {"\xe2\xa4\x99", "\xe2\xa4\x9a", "\xe2\xa4\x9c"}, // ⤙ ⤚ ⤜
+        {"\xe2\xa5\x8a", "\xe2\xa5\x90", "\xe2\x86\xbd", "\xe2\x87\x80"}, // ⥊ ⥐ ↽ ⇀
+        {"\xe2\xa4\xbe", "\xe2\xa4\xbf", "\xe2\xa4\xb8", "\xe2\xa4\xb9", "\xe2\xa4\xbb"}, // ⤾ ⤿ ⤸ ⤹ ⤻
+        {"\xe2\x88\xb4", "\xe2\x88\xb5"}, // ∴ ∵
+        {"\xe2\xa0\x94", "\xe2\xa0\xa2"}, // ⠔ ⠢
+        {"\xe2\x88\xba", "\xe2\x88\xbb"}, // ∺ ∻
+        //{"\xe2\xac\xb7", "\xe2\xa4\x90"}, // ⬷ ⤐
+        {"\xe2\x89\x80"}, // ≀
+        //{"\xe2\xa5\x88"}, // ⥈
+        //{"\xe2\x9e\xbb"} // ➻
+    };
+
+#else
+
+    static const Vector<e::Symbol> allTerms = {
+        "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m",
+        "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z"
+    };
+
+    static const Vector<Vector<e::Symbol>> allOperations = {
+        {"~~", "~"},
+        {"-<", ">-"},
+        {"|-", "-|"},
+        {"~>", "<~", "<~>"},
+        {"-/", "/-"},
+        {":>", "|>", "/>"},
+        {"#", "@"},
+        {"$", "&"},
+        {"?", "!"},
+        {"==<", ">=="},
+        {">>-", "-<<"},
+        {"::"},
+        {"."}
+    };
+
+#endif
+
+    class Interner final
+    {
+    public:
+
+        Interner()
+        {
+            for (const auto &term : allTerms)
+            {
+                this->termIds.push_back(this->add(term));
+            }
+
+            this->numTerms = int(this->symbols.size());
+
+            for (const auto &group : allOperations)
+            {
+                Vector<SymbolId> groupIds;
+                for (const auto &operation : group)
+                {
+                    groupIds.push_back(this->add(operation));
+                }
+
+                this->operationGroupIds.push_back(move(groupIds));
+            }
+
+            assert(this->symbols.size() <= SymbolSet::maxSymbols);
+        }
+
+        SymbolId getId(const e::Symbol &symbol) const
+        {
+            const auto found = this->ids.find(symbol);
+            assert(found != this->ids.end()); // not from the alphabet?
+            return found->second;
+        }
+
+        const e::Symbol &getSymbol(SymbolId id) const
+        {
+            assert(int(id) < this->symbols.size());
+            return this->symbols[int(id)];
+        }
+
+        bool isTerm(SymbolId id) const noexcept
+        {
+            return int(id) < this->numTerms;
+        }
+
+        int getNumSymbols() const noexcept
+        {
+            return int(this->symbols.size());
+        }
+
+        const Vector<SymbolId> &getTermIds() const noexcept
+        {
+            return this->termIds;
+        }
+
+        const Vector<Vector<SymbolId>> &getOperationGroupIds() const noexcept
+        {
+            return this->operationGroupIds;
+        }
+
+    private:
+
+        SymbolId add(const e::Symbol &symbol)
+        {
+            assert(!contains(this->ids, symbol));
+            const auto id = SymbolId(this->symbols.size());
+            this->ids[symbol] = id;
+            this->symbols.push_back(symbol);
+            return id;
+        }
+
+        Vector<e::Symbol> symbols;
+        HashMap<e::Symbol, SymbolId> ids;
+
+        Vector<SymbolId> termIds;
+        Vector<Vector<SymbolId>> operationGroupIds;
+
+        int numTerms = 0;
+    };
+
+    // built once, never modified after that, so it's safe to use from any thread
+    inline const Interner &getInterner()
+    {
+        static const Interner interner;
+        return interner;
+    }
+
+    inline SymbolId getId(const e::Symbol &symbol)
+    {
+        return getInterner().getId(symbol);
+    }
+
+    inline const e::Symbol &getSymbol(SymbolId id)
+    {
+        return getInterner().getSymbol(id);
+    }
+
+    inline bool isTerm(SymbolId id)
+    {
+        return getInterner().isTerm(id);
+    }
+} // namespace Alphabet
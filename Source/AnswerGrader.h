@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Common.h"
+#include "Quest.h"
+#include "Parser.h"
+
+// Checks answers against one level of a quest without touching the game state,
+// e.g. to re-grade logged player answers offline, or for the game itself;
+// whatever can be shared between the answers is kept between them:
+// the verdicts for the answers seen before (the same answers tend to repeat a lot),
+// and the results of matching sub-expressions against the classes;
+// both are limited in size, and start over when full, so that grading
+// any number of distinct answers doesn't take any more memory
+
+class AnswerGrader final
+{
+public:
+
+    AnswerGrader(const Quest &quest, int levelNumber) :
+        quest(quest), levelNumber(levelNumber), matcher(quest)
+    {
+        assert(levelNumber >= 0 && levelNumber < quest.levels.size());
+    }
+
+    bool grade(const String &answer)
+    {
+        const auto found = this->verdicts.find(answer);
+        if (found != this->verdicts.end())
+        {
+            return found->second;
+        }
+
+        const auto verdict = this->check(answer);
+        if (this->verdicts.size() >= AnswerGrader::maxNumVerdicts)
+        {
+            this->verdicts.clear();
+        }
+
+        this->verdicts[answer] = verdict;
+        return verdict;
+    }
+
+    Vector<bool> grade(const Vector<String> &answers)
+    {
+        Vector<bool> result;
+        result.reserve(answers.size());
+        for (const auto &answer : answers)
+        {
+            result.push_back(this->grade(answer));
+        }
+        return result;
+    }
+
+private:
+
+    bool check(const String &answer)
+    {
+        const auto &level = this->quest.levels[this->levelNumber];
+
+        try
+        {
+            const auto pattern = Parser::makePattern(answer);
+            if (!pattern.term)
+            {
+                return false;
+            }
+
+            int size = 0;
+            const auto hash = this->quest.getAnswerHash(*pattern.term, size);
+
+            if (size <= Quest::maxPrecomputedAnswerSize ||
+                contains(level.validAnswerHashes, hash))
+            {
+                return this->quest.isValidAnswerHash(this->levelNumber, hash);
+            }
+
+            // shouldn't accept the question itself as an answer
+            return hash != level.questionHash &&
+                this->matcher.match(*pattern.term, level.questionClass);
+        }
+        catch (...) {}
+
+        return false;
+    }
+
+    const Quest &quest;
+    const int levelNumber;
+
+    static constexpr size_t maxNumVerdicts = 64 * 1024;
+
+    HashMap<String, bool> verdicts;
+    Quest::PatternMatcher matcher;
+};
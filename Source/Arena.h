@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Common.h"
+
+#include <memory>
+#include <memory_resource>
+
+// A generation attempt makes thousands of small objects (hints, their trees,
+// the scratch containers of the enumeration and of picking the levels) and most
+// attempts throw them all away; these come from arenas, monotonic buffers that never
+// free anything on their own, so that dropping them means releasing a few
+// big blocks, instead of freeing every object one by one;
+// the hints live in the attempt's arena, as long as the levels made of them,
+// while each phase keeps its scratch in a local arena, released when it returns;
+// an arena is not thread-safe, so each thread making objects has its own one
+
+using Arena = std::pmr::monotonic_buffer_resource;
+
+template <typename T>
+using ArenaVector = std::pmr::vector<T>;
+
+template <typename K, typename V>
+using ArenaHashMap = std::pmr::unordered_map<K, V>;
+
+template <typename K>
+using ArenaHashSet = std::pmr::unordered_set<K>;
+
+// for allocate_shared: each object allocated with it keeps its arena alive,
+// so that the arena goes away along with the last object it has made,
+// e.g. when the levels of the attempt that made them are destroyed
+template <typename T>
+class ArenaAllocator final
+{
+public:
+
+    using value_type = T;
+
+    explicit ArenaAllocator(std::shared_ptr<Arena> arena) noexcept :
+        arena(move(arena)) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept :
+        arena(other.arena) {}
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(this->arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    // the memory is only freed with the whole arena
+    void deallocate(T *, size_t) noexcept {}
+
+    friend bool operator==(const ArenaAllocator &l, const ArenaAllocator &r) noexcept
+    {
+        return l.arena == r.arena;
+    }
+
+    friend bool operator!=(const ArenaAllocator &l, const ArenaAllocator &r) noexcept
+    {
+        return l.arena != r.arena;
+    }
+
+private:
+
+    template <typename U>
+    friend class ArenaAllocator;
+
+    std::shared_ptr<Arena> arena;
+};
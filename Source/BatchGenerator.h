@@ -0,0 +1,138 @@
+#pragma once
+
+#include "Common.h"
+#include "Random.h"
+#include "QuestGenerator.h"
+#include "Quest.h"
+#include "GenerationStats.h"
+#include "PropertyStats.h"
+#include "QuestSkeletonCache.h"
+#include "EGraph.h"
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+// Generates many quests at once on a pool of worker threads,
+// used for refilling the quest pool offline; each worker owns its e-graph,
+// so the only shared state is the counter of claimed quests
+// and whatever the callback decides to lock (and the property stats, if any);
+// quest ids are derived from the base seed and the quest index, so a batch
+// is reproducible regardless of the number of threads (but not the order
+// of the output), unless the property selection is adaptive
+
+class BatchGenerator final
+{
+public:
+
+    // a quest as it comes out of the generator: the levels over their e-graph,
+    // which are enough for formatting it, and the playable Quest, which is only
+    // built when asked for, since computing all its answer hashes takes
+    // about as long as generating it; the quests made by the skeleton cache
+    // come as Quests already, without the levels
+    struct GeneratedQuest final
+    {
+        QuestId id = 0;
+        const e::Graph *eGraph = nullptr;
+        const Vector<Level> *levels = nullptr;
+        Optional<Quest> quest;
+
+        Quest makeQuest() const
+        {
+            return this->quest.has_value() ? *this->quest :
+                Quest::fromGenerated(this->id, *this->eGraph, *this->levels);
+        }
+    };
+
+    // called from worker threads, as soon as a quest is ready,
+    // so it's up to the callback to synchronize the output
+    using Callback = std::function<void(const GeneratedQuest &quest, const GenerationStats &stats)>;
+
+    BatchGenerator(int numQuests, int numThreads, uint64_t seed) :
+        numQuests(numQuests), numThreads(std::max(1, numThreads)), seed(seed) {}
+
+    // the outcomes of all attempts are added to these,
+    // and the adaptive ones also steer the property selection
+    void setPropertyStats(PropertyStats *stats)
+    {
+        this->propertyStats = stats;
+    }
+
+    // if set, most quests are made by renaming the symbols of the cached ones,
+    // and the callback gets no levels for them, only the Quests
+    void setSkeletonCache(QuestSkeletonCache *cache)
+    {
+        this->skeletonCache = cache;
+    }
+
+    void run(const Callback &onQuestGenerated)
+    {
+        this->numClaimedQuests = 0;
+
+        Vector<std::thread> workers;
+        for (int i = 0; i < this->numThreads; ++i)
+        {
+            workers.emplace_back([this, &onQuestGenerated]()
+            {
+                this->runWorker(onQuestGenerated);
+            });
+        }
+
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+private:
+
+    void runWorker(const Callback &onQuestGenerated)
+    {
+        while (true)
+        {
+            const auto questIndex = this->numClaimedQuests.fetch_add(1);
+            if (questIndex >= this->numQuests)
+            {
+                break;
+            }
+
+            const auto questId = Random::mixSeed(this->seed, questIndex);
+
+            GeneratedQuest generatedQuest;
+            generatedQuest.id = questId;
+            GenerationStats stats;
+
+            if (this->skeletonCache != nullptr)
+            {
+                {
+                    GenerationStats::Timer timer(stats.totalSeconds);
+                    generatedQuest.quest = this->skeletonCache->generate(questId, &stats, this->propertyStats);
+                }
+
+                onQuestGenerated(generatedQuest, stats);
+                continue;
+            }
+
+            e::Graph eGraph;
+            Vector<Level> levels;
+            {
+                GenerationStats::Timer timer(stats.totalSeconds);
+                QuestGenerator::generate(questId, eGraph, levels, &stats, this->propertyStats);
+            }
+
+            generatedQuest.eGraph = &eGraph;
+            generatedQuest.levels = &levels;
+            onQuestGenerated(generatedQuest, stats);
+        }
+    }
+
+    const int numQuests;
+    const int numThreads;
+    const uint64_t seed;
+
+    std::atomic<int> numClaimedQuests {0};
+
+    PropertyStats *propertyStats = nullptr;
+
+    QuestSkeletonCache *skeletonCache = nullptr;
+};
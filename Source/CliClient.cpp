@@ -1,15 +1,34 @@
 
 #include "Common.h"
 #include "Game.h"
+#include "BatchGenerator.h"
+#include "QuestPool.h"
+#include "Json.h"
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <mutex>
 #include <ostream>
 
+String formatStats(const GenerationStats &stats, const String &format)
+{
+    return format == "prometheus" ? stats.toPrometheus() : (stats.toJson() + "\n");
+}
+
 // for debugging purposes
 class CliClient final : public Game
 {
 public:
 
-    void onStartGame() override {}
+    void onStartGame() override
+    {
+        std::cout << "Quest " << this->getQuestId() << std::endl;
+
+        if (!this->statsFormat.empty())
+        {
+            std::cerr << formatStats(this->getGenerationStats(), this->statsFormat);
+        }
+    }
 
     void onStartLevel(int levelNumber, const Vector<String> &hints,
         const String &question, const Vector<String> &) override
@@ -31,10 +50,43 @@ public:
         std::cout << (win ? "Win!" : "Oh no.") << std::endl;
     }
 
-    void run()
+    void run(Optional<QuestId> questId)
     {
-        this->generate();
+        if (questId.has_value())
+        {
+            this->generate(*questId);
+        }
+        else
+        {
+            this->generate();
+        }
 
+        this->loop();
+    }
+
+    void run(const QuestPool &pool)
+    {
+        Random random;
+        auto quest = pool.loadRandom(random);
+        if (!quest.has_value())
+        {
+            std::cerr << "The quest pool is empty or broken" << std::endl;
+            return;
+        }
+
+        this->start(move(*quest));
+        this->loop();
+    }
+
+    bool shouldStop = false;
+
+    // "json" or "prometheus", if the generation stats should be printed
+    String statsFormat;
+
+private:
+
+    void loop()
+    {
         while (!this->shouldStop)
         {
             String input;
@@ -42,12 +94,203 @@ public:
             this->validateAnswer(input.c_str());
         }
     }
-
-    bool shouldStop = false;
 };
 
+Vector<String> formatHints(const Vector<Hint::Ptr> &hints)
+{
+    Vector<String> result;
+    for (const auto &hint : hints)
+    {
+        result.push_back(hint->getFormattedAscii());
+    }
+    return result;
+}
+
+// one quest per line, so the output can be streamed and concatenated
+String formatQuestAsJsonLine(QuestId questId, const Vector<Level> &levels)
+{
+    // ids are written as strings, since JSON numbers can't hold all 64 bits
+    String result = "{\"id\":\"" + std::to_string(questId) + "\",\"levels\":[";
+    for (int i = 0; i < levels.size(); ++i)
+    {
+        const auto &level = levels[i];
+        result += (i > 0 ? "," : "");
+        result += "{\"hint\":\"" + escapeJson(level.getFormattedHint()) + "\"";
+        result += ",\"question\":\"" + escapeJson(level.question->getFormattedAscii()) + "\"";
+        result += ",\"operation\":\"" + escapeJson(Alphabet::getSymbol(level.operation)) + "\"";
+        result += ",\"answers\":" + formatJsonArray(formatHints(level.answers));
+        result += ",\"suggestions\":" + formatJsonArray(level.suggestions) + "}";
+    }
+    return result + "]}";
+}
+
+// usage: game --generate N [--threads T] [--seed S] [--out quests.jsonl] [--pool quests.pool]
+//             [--stats json|prometheus] [--properties uniform|adaptive] [--skeletons K]
+int generateQuests(const HashMap<String, String> &options)
+{
+    const auto seed = contains(options, "--seed") ?
+        std::stoull(options.at("--seed")) : Random::makeRandomSeed();
+
+    const auto numQuests = std::stoi(options.at("--generate"));
+    const auto numThreads = contains(options, "--threads") ?
+        std::stoi(options.at("--threads")) : int(std::thread::hardware_concurrency());
+
+    std::ofstream file;
+    if (contains(options, "--out"))
+    {
+        file.open(options.at("--out"));
+        if (!file.is_open())
+        {
+            std::cerr << "Cannot open " << options.at("--out") << std::endl;
+            return 1;
+        }
+    }
+
+    auto &output = file.is_open() ? file : std::cout;
+
+    QuestPoolWriter pool;
+    const bool writesPool = contains(options, "--pool");
+    if (writesPool && !pool.open(options.at("--pool")))
+    {
+        std::cerr << "Cannot open " << options.at("--pool") << std::endl;
+        return 1;
+    }
+
+    int numWrittenQuests = 0;
+    int numRejectedQuests = 0;
+    GenerationStats totalStats;
+
+    // the adaptive selection learns which properties work as the batch goes,
+    // so the quests will differ from the ones generated by their ids alone
+    PropertyStats propertyStats(contains(options, "--properties") &&
+        options.at("--properties") == "adaptive");
+
+    std::mutex outputMutex;
+    const auto startTime = std::chrono::steady_clock::now();
+
+    BatchGenerator generator(numQuests, numThreads, seed);
+    generator.setPropertyStats(&propertyStats);
+
+    // --skeletons K generates K quests and makes the rest by renaming their symbols,
+    // which is much faster, but only the pool can store such quests
+    // (the JSON output needs the hints they don't have)
+    QuestSkeletonCache skeletonCache(contains(options, "--skeletons") ?
+        std::stoi(options.at("--skeletons")) : 0);
+
+    if (contains(options, "--skeletons"))
+    {
+        if (!writesPool)
+        {
+            std::cerr << "--skeletons only works with --pool" << std::endl;
+            return 1;
+        }
+
+        generator.setSkeletonCache(&skeletonCache);
+    }
+    generator.run([&](const BatchGenerator::GeneratedQuest &generatedQuest, const GenerationStats &stats)
+    {
+        if (writesPool)
+        {
+            // only the quests that can actually be played go into the pool
+            const auto quest = generatedQuest.makeQuest();
+            const auto isValid = quest.hasValidSuggestions();
+            std::lock_guard<std::mutex> lock(outputMutex);
+            totalStats.add(stats);
+            if (isValid)
+            {
+                pool.add(quest);
+                numWrittenQuests++;
+            }
+            else
+            {
+                numRejectedQuests++;
+            }
+            return;
+        }
+
+        // format outside of the lock, only the write itself is serialized
+        const auto line = formatQuestAsJsonLine(generatedQuest.id, *generatedQuest.levels);
+        std::lock_guard<std::mutex> lock(outputMutex);
+        totalStats.add(stats);
+        output << line << '\n';
+        numWrittenQuests++;
+    });
+
+    output.flush();
+
+    if (writesPool && !pool.close())
+    {
+        std::cerr << "Cannot write " << options.at("--pool") << std::endl;
+        return 1;
+    }
+
+    // summed over all quests, so the total time is the sum of all threads' time
+    if (contains(options, "--stats"))
+    {
+        std::cerr << formatStats(totalStats, options.at("--stats"));
+
+        // too many combinations for a metric
+        if (options.at("--stats") == "json")
+        {
+            std::cerr << propertyStats.toJson() << std::endl;
+        }
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    std::cerr << "Generated " << numQuests << " quests on " << numThreads << " threads in "
+              << elapsed.count() << "s (" << (numQuests / elapsed.count()) << " quests/s), wrote "
+              << numWrittenQuests << ", rejected " << numRejectedQuests << " unplayable" << std::endl;
+
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
+    HashMap<String, String> options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        options[argv[i]] = argv[i + 1];
+    }
+
+    if (contains(options, "--generate"))
+    {
+        return generateQuests(options);
+    }
+
+    // game --quest ID replays a specific quest
+    Optional<QuestId> questId;
+    if (contains(options, "--quest"))
+    {
+        questId = std::stoull(options.at("--quest"));
+    }
+
     CliClient game;
-    game.run(); // run.game.run();
+
+    // game --stats json|prometheus prints what the generation has been busy with
+    if (contains(options, "--stats"))
+    {
+        game.statsFormat = options.at("--stats");
+    }
+
+    // game --threads T runs several generation attempts at once
+    if (contains(options, "--threads"))
+    {
+        game.setNumGenerationThreads(std::stoi(options.at("--threads")));
+    }
+
+    // game --pool quests.pool plays a random pre-generated quest
+    if (contains(options, "--pool"))
+    {
+        QuestPool pool;
+        if (!pool.open(options.at("--pool")))
+        {
+            std::cerr << "Cannot open " << options.at("--pool") << std::endl;
+            return 1;
+        }
+
+        game.run(pool);
+        return 0;
+    }
+
+    game.run(questId);
 }
@@ -1,9 +1,11 @@
 ﻿#pragma once
 
 #include <cassert>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <optional>
+#include <map>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -18,6 +20,10 @@ using HashMap = std::unordered_map<K, V, H, E>;
 template <typename K, typename H = std::hash<K>, typename E = std::equal_to<K>>
 using HashSet = std::unordered_set<K, H, E>;
 
+// for the cases when iteration order matters, e.g. to make generation reproducible
+template <typename K, typename V, typename C = std::less<K>>
+using SortedMap = std::map<K, V, C>;
+
 template <typename T>
 using Optional = std::optional<T>;
 
@@ -41,6 +47,35 @@ inline void append(HashSet<T> &s1, const HashSet<T> &s2)
     s1.insert(s2.begin(), s2.end());
 }
 
+// FNV-1a over the bytes of 64-bit values; unlike std::hash, it gives
+// the same results on all platforms, so it's safe to use in anything
+// that affects the generated quests
+namespace Hashing
+{
+    static constexpr uint64_t initialValue = 14695981039346656037ull;
+    static constexpr uint64_t prime = 1099511628211ull;
+
+    inline constexpr uint64_t combine(uint64_t hash, uint64_t value) noexcept
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            hash ^= (value >> (i * 8)) & 0xff;
+            hash *= prime;
+        }
+        return hash;
+    }
+
+    inline uint64_t combine(uint64_t hash, const String &value) noexcept
+    {
+        for (const auto c : value)
+        {
+            hash ^= uint8_t(c);
+            hash *= prime;
+        }
+        return hash;
+    }
+} // namespace Hashing
+
 namespace Symbols
 {
 #if WEB_CLIENT
@@ -4,6 +4,9 @@
 #include "Random.h"
 #include "Parser.h"
 #include "QuestGenerator.h"
+#include "Quest.h"
+#include "AnswerGrader.h"
+#include "GenerationStats.h"
 #include "EGraph.h"
 
 class Game
@@ -27,14 +30,14 @@ public:
     void validateAnswer(int suggestionIndex)
     {
         bool isValidPick = false;
-        Vector<bool> answersIndices;
         const auto &currentLevel = this->getCurrentLevel();
+        Vector<bool> answersIndices(currentLevel.suggestions.size());
 
         for (int i = 0; i < currentLevel.suggestions.size(); ++i)
         {
-            const auto suggestion = currentLevel.suggestions[i];
-            const bool suggestionIsValidAnswer = this->isValidAnswer(suggestion);
-            
+            const bool suggestionIsValidAnswer =
+                this->quest.isValidSuggestion(this->currentLevelNumber, i);
+
             isValidPick = isValidPick ||
                 (suggestionIndex == i && suggestionIsValidAnswer);
 
@@ -68,55 +71,52 @@ public:
         }
     }
 
-    bool isValidAnswer(const String &expression) const
+    // how many generation attempts to run at once (where threads are available)
+    void setNumGenerationThreads(int numThreads)
     {
-        try
-        {
-            const auto pattern = Parser::makePattern(expression);
-            if (!pattern.term)
-            {
-                return false;
-            }
-
-            // shouldn't accept the question itself as an answer:
-            const auto formattedAnswer = Parser::formatPatternTerm(*pattern.term, false);
-            if (this->getCurrentLevel().question->formatted == formattedAnswer) // todo should compare ASTs here instead but whatever
-            {
-                return false;
-            }
-
-            bool isValidAnswer = false;
-            for (const auto &[classId, _classPtr] : this->eGraph.classes)
-            {
-                isValidAnswer = isValidAnswer ||
-                    (classId == this->getCurrentLevel().question->rootId &&
-                        this->matchPatternTerm(*pattern.term, classId));
-            }
-
-            return isValidAnswer;
-        }
-        catch (...) {}
+        this->numGenerationThreads = std::max(1, numThreads);
+    }
 
-        return false;
+    QuestId getQuestId() const noexcept
+    {
+        return this->quest.id;
+    }
+
+    // what the last generate() has been busy with,
+    // empty if the quest was started from a pool
+    const GenerationStats &getGenerationStats() const noexcept
+    {
+        return this->generationStats;
+    }
+
+    // not const, the grader remembers the answers it has seen
+    bool isValidAnswer(const String &expression)
+    {
+        assert(this->answerGrader.has_value());
+        return this->answerGrader->grade(expression);
     }
 
 protected:
 
-    const Level &getCurrentLevel() const
+    const QuestLevel &getCurrentLevel() const
     {
-        assert(this->currentLevelNumber >= 0 && this->currentLevelNumber < this->levels.size());
-        return this->levels[this->currentLevelNumber];
+        assert(this->currentLevelNumber >= 0 && this->currentLevelNumber < this->quest.levels.size());
+        return this->quest.levels[this->currentLevelNumber];
     }
 
     void proceedToLevel(int levelNumber)
     {
         this->currentLevelNumber = levelNumber;
-        if (this->currentLevelNumber < this->levels.size())
+        this->answerGrader.reset();
+        if (this->currentLevelNumber < this->quest.levels.size())
         {
+            // one grader for all the answers to the level, so that they share what it remembers
+            this->answerGrader.emplace(this->quest, this->currentLevelNumber);
+
             const auto &currentLevel = this->getCurrentLevel();
             this->onStartLevel(this->currentLevelNumber,
-                {currentLevel.getFormattedHint()},
-                currentLevel.question->formatted + " " + Symbols::equalsSign,
+                {currentLevel.hint},
+                currentLevel.question + " " + Symbols::equalsSign,
                 currentLevel.suggestions);
         }
         else
@@ -127,64 +127,50 @@ protected:
 
     void generate()
     {
-        bool hasResult = false;
-        int numAttempts = 0;
+        this->generate(Random::makeRandomSeed());
+    }
+
+    void generate(QuestId questId)
+    {
+        e::Graph eGraph;
+        Vector<Level> levels;
 
-        while (!hasResult)
+        GenerationStats stats;
         {
-            this->eGraph = {};
-            this->levels = {};
+            GenerationStats::Timer timer(stats.totalSeconds);
 
-            QuestGenerator generator(this->eGraph, this->random);
-            hasResult = generator.tryGenerate(levels);
+#if WEB_CLIENT
+            const auto numAttempts = QuestGenerator::generate(questId, eGraph, levels, &stats);
+#else
+            const auto numAttempts = QuestGenerator::generate(questId,
+                this->numGenerationThreads, eGraph, levels, &stats);
+#endif
 
-            numAttempts++;
             assert(numAttempts < 10); // probably stuck forever
         }
 
-        this->onStartGame();
-        this->proceedToLevel(0);
+        this->start(Quest::fromGenerated(questId, eGraph, levels), move(stats));
     }
 
-private:
-
-    bool matchPatternTerm(const PatternTerm &patternTerm, ClassId classId) const
+    // starts a quest generated earlier, e.g. the one picked from a quest pool
+    void start(Quest quest, GenerationStats stats = {})
     {
-        const auto rootId = this->eGraph.find(classId);
-        assert(contains(this->eGraph.classes, rootId));
-
-        for (const auto &term : this->eGraph.classes.at(rootId)->terms)
-        {
-            if (term->name != patternTerm.name ||
-                term->childrenIds.size() != patternTerm.arguments.size())
-            {
-                continue;
-            }
-
-            bool childrenMatch = true;
-            for (int i = 0; i < patternTerm.arguments.size(); ++i)
-            {
-                assert(patternTerm.arguments[i].term.get() != nullptr);
-                childrenMatch = childrenMatch &&
-                    this->matchPatternTerm(*patternTerm.arguments[i].term, term->childrenIds[i]);
-            }
-
-            if (childrenMatch)
-            {
-                return true;
-            }
-        }
-
-        return false;
+        this->generationStats = move(stats);
+        this->quest = move(quest);
+        this->onStartGame();
+        this->proceedToLevel(0);
     }
 
 private:
 
-    Vector<Level> levels;
+    Quest quest;
+
+    GenerationStats generationStats;
 
     int currentLevelNumber = 0;
 
-    e::Graph eGraph;
+    // of the current level, made when the level starts
+    Optional<AnswerGrader> answerGrader;
 
-    Random random;
+    int numGenerationThreads = 1;
 };
@@ -0,0 +1,273 @@
+
+#include "Common.h"
+#include "Game.h"
+#include "AlienAlgebra.h"
+#include "Parser.h"
+#include "QuestGenerator.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+// Times each phase of the generation separately over a fixed set of seeds
+// and property combinations, so that the numbers are comparable between runs
+// and between commits, and the whole generation over a fixed set of quest ids;
+// usage: bench [--seeds K] [--quests N] [--seed S] [--repeats R]
+
+// the property combinations the phases are timed with, one property per level;
+// they are listed by their templates, not by their indices in AlienAlgebra::allProperties,
+// so that the timings don't silently change meaning when the properties change,
+// and the bench refuses to run if any of these is gone
+static const Vector<Vector<String>> benchCombinations =
+{
+    {"$x . $x => $x", "($x . $y) . $z => $x . ($y . $z)",
+        "($x . $y) . $z => $x . $y", "($x . $y) . $z => $z . ($y . $x)"},
+    {"$x . $y => $y . $x", "$x . ($y . $z) => ($x . $y) . $z",
+        "$x . ($y . $z) => $y . $x", "$x . ($y . $z) => ($z . $y) . $x"},
+    {"$x . $y => $x", "($x . $y) . $z => $z . ($x . $y)",
+        "($x . $y) . $z => $y . $z", "($x . $y) . $z => ($x . $y) . ($y . $x)"},
+    {"$x . $y => $y", "$x . $y => $y . $x",
+        "$x . ($y . $z) => $x . $z", "$x . ($y . $z) => ($y . $z) . $x"},
+    {"$x . $y => $x . $x", "$x . ($y . $z) => ($z . $x) . $y",
+        "($x . $y) . $z => $z . $z", "$x . ($y . $z) => ($z . $z) . ($z . $y)"},
+    {"$x . $y => $y . $y", "($x . $y) . $z => $y . ($z . $x)",
+        "($x . $y) . $z => ($y . $x) . ($x . $x)", "($x . $y) . $z => $y . ($x . $z)"},
+    {"$x . $y => $y . $x", "$x . ($y . $z) => ($x . $z) . $y",
+        "$x . ($y . $z) => ($y . $y) . ($y . $z)", "($x . $y) . $z => ($x . $x) . ($y . $x)"},
+    {"$x . $x => $x", "$x . $y => $y . $x",
+        "($x . $y) . $z => $z . $x", "$x . ($y . $z) => ($x . $z) . $y"},
+};
+
+// as indices in AlienAlgebra::allProperties, or nothing if any of them
+// isn't there anymore, or can't be picked for its level
+Optional<Vector<Vector<int>>> findBenchCombinations()
+{
+    Vector<Vector<int>> result;
+    for (const auto &templates : benchCombinations)
+    {
+        if (templates.size() != QuestGenerator::numLevels)
+        {
+            return {};
+        }
+
+        Vector<int> combination;
+        for (int levelNumber = 0; levelNumber < templates.size(); ++levelNumber)
+        {
+            const auto &all = AlienAlgebra::allProperties;
+            const auto found = std::find_if(all.begin(), all.end(), [&](const OperationProperty &property)
+            {
+                return property.rewriteTemplate == templates[levelNumber];
+            });
+
+            if (found == all.end() || !contains(found->levels, levelNumber))
+            {
+                std::cerr << "Not a property for level " << levelNumber << ": " << templates[levelNumber] << std::endl;
+                return {};
+            }
+
+            combination.push_back(int(found - all.begin()));
+        }
+
+        result.push_back(move(combination));
+    }
+
+    return result;
+}
+
+class Measurements final
+{
+public:
+
+    explicit Measurements(const String &name) :
+        name(name) {}
+
+    template <typename F>
+    auto measure(F &&function)
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+        auto result = function();
+        const std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - startTime;
+        this->durations.push_back(elapsed.count());
+        return result;
+    }
+
+    static void printHeader()
+    {
+        std::cout << std::left << std::setw(24) << "phase" << std::right
+                  << std::setw(10) << "runs" << std::setw(14) << "ops/s"
+                  << std::setw(12) << "p50 us" << std::setw(12) << "p90 us"
+                  << std::setw(12) << "p99 us" << std::setw(12) << "max us" << std::endl;
+    }
+
+    void print()
+    {
+        if (this->durations.empty())
+        {
+            std::cout << std::left << std::setw(24) << this->name << std::right
+                      << std::setw(10) << 0 << std::endl;
+            return;
+        }
+
+        std::sort(this->durations.begin(), this->durations.end());
+
+        double total = 0.0;
+        for (const auto duration : this->durations)
+        {
+            total += duration;
+        }
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::left << std::setw(24) << this->name << std::right
+                  << std::setw(10) << this->durations.size()
+                  << std::setw(14) << (this->durations.size() / (total / 1000000.0))
+                  << std::setw(12) << this->getPercentile(0.5)
+                  << std::setw(12) << this->getPercentile(0.9)
+                  << std::setw(12) << this->getPercentile(0.99)
+                  << std::setw(12) << this->durations.back() << std::endl;
+    }
+
+private:
+
+    // expects sorted durations
+    double getPercentile(double fraction) const
+    {
+        const auto index = size_t(fraction * (this->durations.size() - 1) + 0.5);
+        return this->durations[index];
+    }
+
+    const String name;
+    Vector<double> durations;
+};
+
+// a game without any UI, just to reach the generation and validation
+class BenchGame final : public Game
+{
+public:
+
+    void onStartGame() override {}
+    void onStartLevel(int, const Vector<String> &, const String &, const Vector<String> &) override {}
+    void onEndLevel(bool, const Vector<bool> &) override {}
+    void onEndGame(bool) override
+    {
+        this->hasEnded = true;
+    }
+
+    bool hasEnded = false;
+
+    using Game::generate;
+    using Game::proceedToLevel;
+    using Game::getCurrentLevel;
+};
+
+int main(int argc, char **argv)
+{
+    HashMap<String, String> options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        options[argv[i]] = argv[i + 1];
+    }
+
+    const auto numSeeds = contains(options, "--seeds") ? std::stoi(options.at("--seeds")) : 25;
+    const auto numQuests = contains(options, "--quests") ? std::stoi(options.at("--quests")) : 200;
+    const auto seed = contains(options, "--seed") ? std::stoull(options.at("--seed")) : 1;
+    const auto numRepeats = contains(options, "--repeats") ? std::stoi(options.at("--repeats")) : 100;
+
+    const auto combinations = findBenchCombinations();
+    if (!combinations.has_value())
+    {
+        std::cerr << "The bench combinations are out of date with AlienAlgebra::allProperties" << std::endl;
+        return 1;
+    }
+
+    Measurements parsing("parse rewrite rule");
+    Measurements saturation("build e-graph");
+    Measurements extraction("extract hints");
+    Measurements ranking("build levels");
+    Measurements validation("validate answer");
+    Measurements generation("generate quest");
+
+    // all property templates, the same way the generator parses them
+    for (int i = 0; i < numRepeats; ++i)
+    {
+        for (const auto &property : AlienAlgebra::allProperties)
+        {
+            parsing.measure([&]()
+            {
+                return Parser::makeRewriteRule(property.rewriteTemplate, {});
+            });
+        }
+    }
+
+    // the phases of single attempts with each of the combinations, including the failed ones
+    int numAttempts = 0;
+    int numFailedAttempts = 0;
+    for (const auto &combination : *combinations)
+    {
+        for (int i = 0; i < numSeeds; ++i)
+        {
+            e::Graph eGraph;
+            QuestGenerator generator(eGraph, Random::mixSeed(seed, i));
+            generator.forceProperties(combination);
+            numAttempts++;
+
+            Vector<HashSet<ClassId>> questClasses;
+            if (!saturation.measure([&]() { return generator.buildEGraph(questClasses); }))
+            {
+                numFailedAttempts++;
+                continue;
+            }
+
+            const auto allExpressions = extraction.measure([&]() { return generator.extractHints(); });
+
+            Vector<Level> levels;
+            if (!ranking.measure([&]() { return generator.buildLevels(allExpressions, questClasses, levels); }))
+            {
+                numFailedAttempts++;
+            }
+        }
+    }
+
+    // whole quests, as the game generates them, and the answer checks for them:
+    // every suggestion, and the question itself, which must be rejected
+    for (int i = 0; i < numQuests; ++i)
+    {
+        BenchGame game;
+        generation.measure([&]()
+        {
+            game.generate(Random::mixSeed(seed, i));
+            return true;
+        });
+
+        for (int levelNumber = 0;; ++levelNumber)
+        {
+            // this makes the level's answer grader, so only the grading itself is timed
+            game.proceedToLevel(levelNumber);
+            if (game.hasEnded)
+            {
+                break;
+            }
+
+            const auto &level = game.getCurrentLevel();
+
+            Vector<String> answers = level.suggestions;
+            answers.push_back(level.question);
+
+            for (const auto &answer : answers)
+            {
+                validation.measure([&]() { return game.isValidAnswer(answer); });
+            }
+        }
+    }
+
+    Measurements::printHeader();
+    parsing.print();
+    saturation.print();
+    extraction.print();
+    ranking.print();
+    generation.print();
+    validation.print();
+
+    std::cout << numFailedAttempts << " of " << numAttempts << " attempts with the bench combinations failed" << std::endl;
+    return 0;
+}
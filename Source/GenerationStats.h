@@ -0,0 +1,214 @@
+#pragma once
+
+#include "Common.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+// why a generation attempt has given up
+enum class FailureReason
+{
+    None,
+    Cancelled,
+    GraphExplosion,
+    NoExpressions,
+    NoQuestion,
+    NoAnswers,
+    NoHintWithOperation,
+    // succeeded, but an earlier attempt running in parallel has succeeded too, and won
+    Superseded
+};
+
+static constexpr auto numFailureReasons = int(FailureReason::Superseded) + 1;
+
+inline const char *getFailureReasonName(FailureReason reason)
+{
+    switch (reason)
+    {
+        case FailureReason::None: return "none";
+        case FailureReason::Cancelled: return "cancelled";
+        case FailureReason::GraphExplosion: return "graphExplosion";
+        case FailureReason::NoExpressions: return "noExpressions";
+        case FailureReason::NoQuestion: return "noQuestion";
+        case FailureReason::NoAnswers: return "noAnswers";
+        case FailureReason::NoHintWithOperation: return "noHintWithOperation";
+        case FailureReason::Superseded: return "superseded";
+    }
+
+    assert(false);
+    return "";
+}
+
+// What the generation has been busy with, to tell if a slow one was
+// because of retries, the e-graph blowing up, or the hints extraction;
+// the times and the counters are summed over all attempts, including
+// the failed and cancelled ones, while the graph sizes before and during
+// the saturation, and the properties picked, are only kept for the attempt that has succeeded
+
+struct GenerationStats final
+{
+    struct GraphSize final
+    {
+        int numClasses = 0;
+        int numNodes = 0;
+    };
+
+    int numAttempts = 0;
+    int numFailedAttempts = 0;
+
+    // indexed by FailureReason, so the first one is always zero
+    std::array<int, numFailureReasons> numFailuresByReason {};
+
+    // the wall time of the whole generation, which may be less
+    // than the sum of the phases when attempts run in parallel
+    double totalSeconds = 0.0;
+
+    double buildEGraphSeconds = 0.0;
+    double extractHintsSeconds = 0.0;
+    double buildLevelsSeconds = 0.0;
+
+    // the size before the saturation and after each of its passes
+    GraphSize initialGraphSize;
+    Vector<GraphSize> rewritePasses;
+    GraphSize peakGraphSize;
+
+    // one per level, as indices in AlienAlgebra::allProperties
+    Vector<int> propertyIndices;
+
+    // all the expressions the enumeration could produce, the ones
+    // it has kept within the per-class limit, and the ones that made it into hints
+    uint64_t numCandidateExpressions = 0;
+    uint64_t numEnumeratedExpressions = 0;
+    uint64_t numHints = 0;
+
+    void add(const GenerationStats &other)
+    {
+        this->numAttempts += other.numAttempts;
+        this->numFailedAttempts += other.numFailedAttempts;
+        for (int i = 0; i < numFailureReasons; ++i)
+        {
+            this->numFailuresByReason[i] += other.numFailuresByReason[i];
+        }
+
+        this->totalSeconds += other.totalSeconds;
+        this->buildEGraphSeconds += other.buildEGraphSeconds;
+        this->extractHintsSeconds += other.extractHintsSeconds;
+        this->buildLevelsSeconds += other.buildLevelsSeconds;
+        this->peakGraphSize.numClasses = std::max(this->peakGraphSize.numClasses, other.peakGraphSize.numClasses);
+        this->peakGraphSize.numNodes = std::max(this->peakGraphSize.numNodes, other.peakGraphSize.numNodes);
+        this->numCandidateExpressions += other.numCandidateExpressions;
+        this->numEnumeratedExpressions += other.numEnumeratedExpressions;
+        this->numHints += other.numHints;
+    }
+
+    void addRewritePass(int numClasses, int numNodes)
+    {
+        this->rewritePasses.push_back({numClasses, numNodes});
+        this->peakGraphSize.numClasses = std::max(this->peakGraphSize.numClasses, numClasses);
+        this->peakGraphSize.numNodes = std::max(this->peakGraphSize.numNodes, numNodes);
+    }
+
+    String toJson() const
+    {
+        String result = "{\"numAttempts\":" + std::to_string(this->numAttempts);
+        result += ",\"numFailedAttempts\":" + std::to_string(this->numFailedAttempts);
+        result += ",\"failureReasons\":{";
+        for (int i = 1; i < numFailureReasons; ++i)
+        {
+            result += (i > 1 ? ",\"" : "\"") + String(getFailureReasonName(FailureReason(i))) +
+                "\":" + std::to_string(this->numFailuresByReason[i]);
+        }
+        result += "}";
+        result += ",\"totalSeconds\":" + std::to_string(this->totalSeconds);
+        result += ",\"buildEGraphSeconds\":" + std::to_string(this->buildEGraphSeconds);
+        result += ",\"extractHintsSeconds\":" + std::to_string(this->extractHintsSeconds);
+        result += ",\"buildLevelsSeconds\":" + std::to_string(this->buildLevelsSeconds);
+        result += ",\"peakNumClasses\":" + std::to_string(this->peakGraphSize.numClasses);
+        result += ",\"peakNumNodes\":" + std::to_string(this->peakGraphSize.numNodes);
+        result += ",\"numCandidateExpressions\":" + std::to_string(this->numCandidateExpressions);
+        result += ",\"numEnumeratedExpressions\":" + std::to_string(this->numEnumeratedExpressions);
+        result += ",\"numHints\":" + std::to_string(this->numHints);
+        result += ",\"initialNumClasses\":" + std::to_string(this->initialGraphSize.numClasses);
+        result += ",\"initialNumNodes\":" + std::to_string(this->initialGraphSize.numNodes);
+        result += ",\"rewritePasses\":[";
+        for (int i = 0; i < this->rewritePasses.size(); ++i)
+        {
+            result += (i > 0 ? "," : "");
+            result += "{\"numClasses\":" + std::to_string(this->rewritePasses[i].numClasses);
+            result += ",\"numNodes\":" + std::to_string(this->rewritePasses[i].numNodes) + "}";
+        }
+        return result + "]}";
+    }
+
+    // the Prometheus text exposition format
+    String toPrometheus() const
+    {
+        String result;
+        const auto addMetric = [&result](const String &name, const String &type, const String &value)
+        {
+            result += "# TYPE alien_algebra_" + name + " " + type + "\n";
+            result += "alien_algebra_" + name + " " + value + "\n";
+        };
+
+        addMetric("generation_attempts_total", "counter", std::to_string(this->numAttempts));
+        addMetric("generation_failed_attempts_total", "counter", std::to_string(this->numFailedAttempts));
+
+        result += "# TYPE alien_algebra_generation_failures_total counter\n";
+        for (int i = 1; i < numFailureReasons; ++i)
+        {
+            result += "alien_algebra_generation_failures_total{reason=\"" +
+                String(getFailureReasonName(FailureReason(i))) + "\"} " +
+                std::to_string(this->numFailuresByReason[i]) + "\n";
+        }
+
+        addMetric("generation_seconds_total", "counter", std::to_string(this->totalSeconds));
+        addMetric("build_egraph_seconds_total", "counter", std::to_string(this->buildEGraphSeconds));
+        addMetric("extract_hints_seconds_total", "counter", std::to_string(this->extractHintsSeconds));
+        addMetric("build_levels_seconds_total", "counter", std::to_string(this->buildLevelsSeconds));
+        addMetric("peak_egraph_classes", "gauge", std::to_string(this->peakGraphSize.numClasses));
+        addMetric("peak_egraph_nodes", "gauge", std::to_string(this->peakGraphSize.numNodes));
+        addMetric("candidate_expressions_total", "counter", std::to_string(this->numCandidateExpressions));
+        addMetric("enumerated_expressions_total", "counter", std::to_string(this->numEnumeratedExpressions));
+        addMetric("hints_total", "counter", std::to_string(this->numHints));
+
+        if (!this->rewritePasses.empty())
+        {
+            result += "# TYPE alien_algebra_rewrite_pass_classes gauge\n";
+            for (int i = 0; i < this->rewritePasses.size(); ++i)
+            {
+                result += "alien_algebra_rewrite_pass_classes{pass=\"" + std::to_string(i) + "\"} " +
+                    std::to_string(this->rewritePasses[i].numClasses) + "\n";
+            }
+
+            result += "# TYPE alien_algebra_rewrite_pass_nodes gauge\n";
+            for (int i = 0; i < this->rewritePasses.size(); ++i)
+            {
+                result += "alien_algebra_rewrite_pass_nodes{pass=\"" + std::to_string(i) + "\"} " +
+                    std::to_string(this->rewritePasses[i].numNodes) + "\n";
+            }
+        }
+
+        return result;
+    }
+
+    // adds the time spent in a scope to one of the counters above
+    class Timer final
+    {
+    public:
+
+        explicit Timer(double &outSeconds) :
+            outSeconds(outSeconds), startTime(std::chrono::steady_clock::now()) {}
+
+        ~Timer()
+        {
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - this->startTime;
+            this->outSeconds += elapsed.count();
+        }
+
+    private:
+
+        double &outSeconds;
+        const std::chrono::steady_clock::time_point startTime;
+    };
+};
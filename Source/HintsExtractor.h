@@ -2,8 +2,14 @@
 
 #include "Common.h"
 #include "Random.h"
+#include "Alphabet.h"
+#include "Arena.h"
 #include "EGraph.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
 // Helper classes used to extract random expressions
 // from the e-graph along with their class ids and some meta info,
 // so it's more convenient to manage them: group/filter/etc.
@@ -12,83 +18,132 @@ struct Hint final
 {
     using Ptr = std::shared_ptr<Hint>;
 
+    // the trees are allocated along with their hints, see Hint::make
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
     struct AstNode final
     {
+        using allocator_type = Hint::allocator_type;
+
         AstNode() = default;
-        explicit AstNode(const e::Symbol &name) :
-            name(name) {}
+        explicit AstNode(SymbolId symbol, const allocator_type &allocator = {}) :
+            symbol(symbol), children(allocator) {}
+
+        AstNode(const AstNode &other) = default;
+        AstNode(const AstNode &other, const allocator_type &allocator) :
+            symbol(other.symbol), children(other.children, allocator) {}
+
+        AstNode(AstNode &&other) = default;
+        AstNode(AstNode &&other, const allocator_type &allocator) :
+            symbol(other.symbol), children(move(other.children), allocator) {}
+
+        AstNode &operator=(const AstNode &other) = default;
+        AstNode &operator=(AstNode &&other) = default;
 
-        e::Symbol name;
-        Vector<AstNode> children;
+        SymbolId symbol {};
+        ArenaVector<AstNode> children;
     };
 
     Hint() = delete;
     Hint(const Hint &other) = default;
-    explicit Hint(const e::Symbol &rootSymbol)
+    explicit Hint(SymbolId rootSymbol, const allocator_type &allocator = {}) :
+        usedLeafIds(allocator), rootNode(rootSymbol, allocator) {}
+
+    Hint(const Hint &other, const allocator_type &allocator) :
+        rootId(other.rootId), astDepth(other.astDepth), hash(other.hash),
+        usedLeafIds(other.usedLeafIds, allocator), usedSymbols(other.usedSymbols),
+        usedTermSymbols(other.usedTermSymbols), usedOperationSymbols(other.usedOperationSymbols),
+        rootNode(other.rootNode, allocator), formatted(other.formatted), formattedAscii(other.formattedAscii) {}
+
+    // makes the hint and its tree in the arena, which the hint keeps alive
+    template <typename... Args>
+    static Ptr make(const std::shared_ptr<Arena> &arena, Args &&...args)
     {
-        this->rootNode = AstNode(rootSymbol);
+        return std::allocate_shared<Hint>(ArenaAllocator<Hint>(arena),
+            std::forward<Args>(args)..., allocator_type(arena.get()));
     }
 
     e::ClassId rootId = 0;
 
     int astDepth = 0;
-    String formatted;
 
-    HashMap<e::ClassId, int> usedLeafIds;
-    HashSet<e::Symbol> usedSymbols;
-    HashSet<e::Symbol> usedTermSymbols;
-    HashSet<e::Symbol> usedOperationSymbols;
+    // identifies the expression's structure, so that comparing two hints
+    // doesn't require formatting them; computed along with the expression
+    uint64_t hash = 0;
 
-    int getNumNewTerms(const HashSet<e::Symbol> &otherTerms)
+    ArenaHashMap<e::ClassId, int> usedLeafIds;
+    SymbolSet usedSymbols;
+    SymbolSet usedTermSymbols;
+    SymbolSet usedOperationSymbols;
+
+    int getNumNewTerms(const SymbolSet &otherTerms) const noexcept
     {
-        int result = 0;
-        for (const auto &usedSymbol : this->usedTermSymbols)
-        {
-            if (!contains(otherTerms, usedSymbol))
-            {
-                result++;
-            }
-        }
-        return result;
+        return this->usedTermSymbols.countExcept(otherTerms);
+    }
+
+    int getNumNewOperations(const SymbolSet &otherOperations) const noexcept
+    {
+        return this->usedOperationSymbols.countExcept(otherOperations);
     }
 
-    int getNumNewOperations(const HashSet<e::Symbol> &otherOperations)
+    Vector<SymbolId> getNewOperations(const SymbolSet &knownOperations) const
     {
-        int result = 0;
-        for (const auto &usedSymbol : this->usedOperationSymbols)
+        return (this->usedOperationSymbols - knownOperations).toVector();
+    }
+
+    AstNode rootNode;
+
+    // formatting is only needed for the few hints that are shown,
+    // so it's done on the first request and not when the hints are extracted;
+    // this one uses the brackets from Symbols, e.g. ⸄ ⸅ in the web build
+    const String &getFormatted() const
+    {
+        if (!this->formatted.has_value())
         {
-            if (!contains(otherOperations, usedSymbol))
-            {
-                result++;
-            }
+            this->formatted = Hint::formatNode(this->rootNode,
+                Symbols::openingBracket, Symbols::closingBracket, false);
         }
-        return result;
+
+        return *this->formatted;
     }
 
-    Vector<e::Symbol> getNewOperations(const HashSet<e::Symbol> &knownOperations)
+    // the plain ASCII form, same as Parser::formatPatternTerm gives
+    const String &getFormattedAscii() const
     {
-        Vector<e::Symbol> result;
-        for (const auto &usedSymbol : this->usedOperationSymbols)
+#if WEB_CLIENT
+        if (!this->formattedAscii.has_value())
         {
-            if (!contains(knownOperations, usedSymbol))
-            {
-                result.push_back(usedSymbol);
-            }
+            this->formattedAscii = Hint::formatNode(this->rootNode, "(", ")", false);
         }
-        return result;
-    }
 
-    AstNode rootNode;
+        return *this->formattedAscii;
+#else
+        return this->getFormatted();
+#endif
+    }
 
     void collectInfo()
     {
         this->astDepth = Hint::getNodeDepth(this->rootNode);
-        this->formatted = Hint::formatNode(this->rootNode, false);
+        this->hash = Hint::getNodeHash(this->rootNode);
+        this->formatted.reset();
+        this->formattedAscii.reset();
+    }
+
+    // the hash of a node is its symbol combined with the hashes of its children, in order
+    static uint64_t getNodeHash(SymbolId symbol, uint64_t leftHash, uint64_t rightHash) noexcept
+    {
+        return Hashing::combine(Hashing::combine(Hint::getNodeHash(symbol), leftHash), rightHash);
+    }
+
+    static uint64_t getNodeHash(SymbolId symbol) noexcept
+    {
+        return Hashing::combine(Hashing::initialValue, uint64_t(symbol));
     }
 
     // used for generating wrong (hopefully) answers by replacing
     // a random simple node, e.g. a term or a "x . y"-like operation with a symbol
-    void replaceRandomNode(Random &random, const e::Symbol &replacementSymbol)
+    void replaceRandomNode(Random &random, SymbolId replacementSymbol)
     {
         Vector<AstNode *> replacementCandidates;
         findReplacementCandidates(this->rootNode, replacementSymbol, replacementCandidates);
@@ -98,7 +153,7 @@ struct Hint final
         }
 
         auto *replacedNode = random.pickOne(replacementCandidates);
-        replacedNode->name = replacementSymbol;
+        replacedNode->symbol = replacementSymbol;
         replacedNode->children = {};
 
         this->collectInfo();
@@ -106,20 +161,35 @@ struct Hint final
 
 private:
 
-    static String formatNode(const AstNode &node, bool wrapWithBrackets = true)
+    // the cached strings, if they were requested already
+    mutable Optional<String> formatted;
+    mutable Optional<String> formattedAscii;
+
+    static String formatNode(const AstNode &node,
+        const String &openingBracket, const String &closingBracket, bool wrapWithBrackets = true)
     {
         // we only generate binary operators and terms
         assert(node.children.size() == 2 || node.children.empty());
         if (node.children.size() == 2)
         {
-            const auto result = formatNode(node.children.front()) +
-                " " + node.name + " " + formatNode(node.children.back());
+            const auto result = formatNode(node.children.front(), openingBracket, closingBracket) +
+                " " + Alphabet::getSymbol(node.symbol) + " " +
+                formatNode(node.children.back(), openingBracket, closingBracket);
 
-            return wrapWithBrackets ?
-                (Symbols::openingBracket + result + Symbols::closingBracket) : result;
+            return wrapWithBrackets ? (openingBracket + result + closingBracket) : result;
         }
 
-        return node.name;
+        return Alphabet::getSymbol(node.symbol);
+    }
+
+    static uint64_t getNodeHash(const AstNode &node)
+    {
+        auto hash = Hint::getNodeHash(node.symbol);
+        for (const auto &child : node.children)
+        {
+            hash = Hashing::combine(hash, Hint::getNodeHash(child));
+        }
+        return hash;
     }
 
     static int getNodeDepth(const AstNode &node)
@@ -133,9 +203,9 @@ private:
     }
 
     static void findReplacementCandidates(AstNode &node,
-        const e::Symbol &replacementSymbol, Vector<AstNode *> &outResult)
+        SymbolId replacementSymbol, Vector<AstNode *> &outResult)
     {
-        if (node.name != replacementSymbol &&
+        if (node.symbol != replacementSymbol &&
             (node.children.empty() ||
                 (node.children.size() == 2 &&
                     node.children.front().children.empty() &&
@@ -155,107 +225,395 @@ class HintsExtractor final
 {
 public:
 
-    explicit HintsExtractor(const e::Graph &eGraph) :
-        eGraph(eGraph) {}
+    // the depth limit also makes sure the enumeration terminates on cyclic classes,
+    // and the per-class limit keeps the combinations from exploding on large graphs
+    static constexpr auto defaultMaxDepth = 8;
+    static constexpr auto defaultMaxHintsPerClass = 32;
+
+    HintsExtractor(const e::Graph &eGraph, uint64_t seed,
+        int maxDepth = HintsExtractor::defaultMaxDepth,
+        int maxHintsPerClass = HintsExtractor::defaultMaxHintsPerClass) :
+        eGraph(eGraph), seed(seed),
+        maxDepth(maxDepth), maxHintsPerClass(maxHintsPerClass) {}
+
+    // how many expressions the enumeration has come across in the classes
+    // that had room for more, and how many of them it has kept, for the stats;
+    // some of the kept ones may still not make it into hints
+    uint64_t getNumCandidateExpressions() const noexcept
+    {
+        uint64_t result = 0;
+        for (const auto numCandidates : this->numCandidatesPerClass)
+        {
+            result += numCandidates;
+        }
+        return result;
+    }
+
+    uint64_t getNumEnumeratedExpressions() const noexcept
+    {
+        uint64_t result = 0;
+        for (const auto &classExpressions : this->expressions)
+        {
+            result += classExpressions.size();
+        }
+        return result;
+    }
+
+    // the hints go into this arena (see Arena.h), and they keep it alive
+    void setArena(std::shared_ptr<Arena> arena)
+    {
+        this->arena = move(arena);
+    }
 
     auto extract()
     {
-        // collect some full trees of expressions for each term
-        HashMap<String, Hint::Ptr> expressions;
-        for (const auto &[termPtr, leafId] : this->eGraph.termsLookup)
+        if (this->arena == nullptr)
+        {
+            this->arena = std::make_shared<Arena>();
+        }
+
+        this->takeSnapshot();
+        this->enumerateExpressions();
+
+        SortedMap<e::ClassId, Vector<Hint::Ptr>> result;
+        for (int classIndex = 0; classIndex < this->classIds.size(); ++classIndex)
         {
-            // I don't have good ideas on how to do exhaustive search here,
-            // so instead will just pick random routes many times and deduplicate;
-            // this class has its own pseudo-random generator with the default seed,
-            // so hints collection will always be the same on the same graph.
-            for (int i = 0; i < 100; ++i)
+            Vector<Hint::Ptr> classHints;
+            for (int i = 0; i < this->expressions[classIndex].size(); ++i)
             {
-                Hint::Ptr expression = std::make_shared<Hint>(termPtr->name);
-                expression->rootId = this->eGraph.find(leafId);
+                if (auto hint = this->makeHint(classIndex, i))
+                {
+                    classHints.push_back(move(hint));
+                }
+            }
 
-                if (this->collectExpressions(expression, expression->rootNode, termPtr, leafId))
+            if (!classHints.empty())
+            {
+                result[this->classIds[classIndex]] = move(classHints);
+            }
+        }
+
+        return result;
+    }
+
+private:
+
+    // an expression is one of the class terms with one expression
+    // picked from each of its children classes; the expressions of a class
+    // are stored in the order of their depth, and the children are
+    // referred to by their indices in their classes' expressions
+    struct Expression final
+    {
+        int termIndex = 0;
+        int depth = 1;
+        int left = -1;
+        int right = -1;
+        uint64_t hash = 0;
+    };
+
+    // a dynamic program over depth: the expressions of depth d in a class
+    // are the class terms applied to all pairs of the children's expressions
+    // of depth < d, where at least one of the pair has depth exactly d - 1;
+    // this way each distinct tree is produced exactly once, shallow ones first,
+    // and when a class has more candidates than it can keep, a uniform
+    // random subset of them is picked without listing them all
+    void enumerateExpressions()
+    {
+        // not the hints' arena, which lives as long as the hints do,
+        // the scratch of the enumeration is all released here at once
+        Arena scratch;
+
+        const auto numClasses = int(this->classTerms.size());
+        this->expressions.assign(numClasses, {});
+        this->numCandidatesPerClass.assign(numClasses, 0);
+
+        for (int classIndex = 0; classIndex < numClasses; ++classIndex)
+        {
+            for (const auto termIndex : this->classTerms[classIndex])
+            {
+                if (!this->terms[termIndex].childrenClasses.empty())
+                {
+                    continue;
+                }
+
+                this->numCandidatesPerClass[classIndex]++;
+                if (this->expressions[classIndex].size() < this->maxHintsPerClass)
                 {
-                    expression->collectInfo();
-                    expressions[expression->formatted] = expression;
+                    this->expressions[classIndex].push_back({termIndex, 1, -1, -1,
+                        Hint::getNodeHash(this->terms[termIndex].symbol)});
                 }
             }
         }
 
-        HashMap<e::ClassId, Vector<Hint::Ptr>> result;
-        for (const auto &[formatted, expression] : expressions)
+        // where the expressions of the previous depth begin and end in each class
+        Vector<int> previousBegins(numClasses, 0);
+        Vector<int> previousEnds(numClasses);
+
+        for (int depth = 2; depth <= this->maxDepth; ++depth)
         {
-            if (!contains(result, expression->rootId))
+            for (int classIndex = 0; classIndex < numClasses; ++classIndex)
             {
-                result[expression->rootId] = {};
+                previousEnds[classIndex] = int(this->expressions[classIndex].size());
             }
 
-            result[expression->rootId].push_back(expression);
-        }
+            // the new expressions are appended only when the whole layer is done,
+            // since they are built from the previous layer only
+            Vector<Vector<Expression>> newExpressions(numClasses);
+            for (int classIndex = 0; classIndex < numClasses; ++classIndex)
+            {
+                newExpressions[classIndex] = this->enumerateExpressions(classIndex,
+                    depth, previousBegins, previousEnds, scratch);
+            }
 
-        return result;
+            bool hasNewExpressions = false;
+            for (int classIndex = 0; classIndex < numClasses; ++classIndex)
+            {
+                hasNewExpressions = hasNewExpressions || !newExpressions[classIndex].empty();
+                append(this->expressions[classIndex], newExpressions[classIndex]);
+            }
+
+            if (!hasNewExpressions)
+            {
+                break;
+            }
+
+            previousBegins = previousEnds;
+        }
     }
 
-    bool collectExpressions(Hint::Ptr expression,
-        Hint::AstNode &parentAstNode, e::Term::Ptr term, e::ClassId termLeafId)
+    Vector<Expression> enumerateExpressions(int classIndex, int depth,
+        const Vector<int> &previousBegins, const Vector<int> &previousEnds, Arena &scratch)
     {
-        bool hasResult = true;
+        const auto capacity = this->maxHintsPerClass - int(this->expressions[classIndex].size());
+        if (capacity <= 0)
+        {
+            return {};
+        }
+
+        // for each binary term of the class, count the pairs of children
+        // where at least one child is from the previous depth:
+        // all pairs minus the pairs where both are older than that
+        ArenaVector<uint64_t> numCandidatesPerTerm(&scratch);
+        uint64_t numCandidates = 0;
+        for (const auto termIndex : this->classTerms[classIndex])
+        {
+            const auto &term = this->terms[termIndex];
+            uint64_t numTermCandidates = 0;
+            if (term.childrenClasses.size() == 2)
+            {
+                const uint64_t numLeft = previousEnds[term.childrenClasses.front()];
+                const uint64_t numRight = previousEnds[term.childrenClasses.back()];
+                const uint64_t numOldLeft = previousBegins[term.childrenClasses.front()];
+                const uint64_t numOldRight = previousBegins[term.childrenClasses.back()];
+                numTermCandidates = numLeft * numRight - numOldLeft * numOldRight;
+            }
 
-        expression->usedLeafIds[termLeafId]++;
-        expression->usedSymbols.insert(term->name);
+            numCandidatesPerTerm.push_back(numTermCandidates);
+            numCandidates += numTermCandidates;
+        }
 
-        if (term->childrenIds.empty())
+        this->numCandidatesPerClass[classIndex] += numCandidates;
+
+        if (numCandidates == 0)
         {
-            expression->usedTermSymbols.insert(term->name);
+            return {};
+        }
+
+        ArenaVector<uint64_t> pickedCandidates(&scratch);
+        if (numCandidates <= uint64_t(capacity))
+        {
+            for (uint64_t i = 0; i < numCandidates; ++i)
+            {
+                pickedCandidates.push_back(i);
+            }
         }
         else
         {
-            expression->usedOperationSymbols.insert(term->name);
+            Random random(Random::mixSeed(Random::mixSeed(this->seed, depth), classIndex));
+
+            // Floyd's sampling: a uniform subset in O(capacity) steps
+            ArenaHashSet<uint64_t> picked(&scratch);
+            for (auto i = numCandidates - capacity; i < numCandidates; ++i)
+            {
+                const auto candidate = random.getRandomIndex(i + 1);
+                picked.insert(contains(picked, candidate) ? i : candidate);
+            }
+
+            pickedCandidates.insert(pickedCandidates.end(), picked.begin(), picked.end());
+            std::sort(pickedCandidates.begin(), pickedCandidates.end());
         }
 
-        for (const auto childClassId : term->childrenIds)
+        // decode the candidate numbers back into the terms and the pairs of children,
+        // the candidates of a term are numbered as the pairs with the new left child,
+        // followed by the pairs with the old left child and the new right child
+        Vector<Expression> result;
+        int termNumber = 0;
+        uint64_t termOffset = 0;
+        for (const auto candidate : pickedCandidates)
         {
-            for (const auto &[classId, classPtr] : this->eGraph.classes)
+            while (candidate >= termOffset + numCandidatesPerTerm[termNumber])
             {
-                if (classId != childClassId)
-                {
-                    continue;
-                }
+                termOffset += numCandidatesPerTerm[termNumber];
+                termNumber++;
+            }
 
-                if (classPtr->terms.empty())
-                {
-                    assert(false); // the e-graph has probably not been rebuilt
-                    return false;
-                }
+            const auto termIndex = this->classTerms[classIndex][termNumber];
+            const auto &term = this->terms[termIndex];
+            const auto leftClass = term.childrenClasses.front();
+            const auto rightClass = term.childrenClasses.back();
+            const uint64_t numRight = previousEnds[rightClass];
+            const uint64_t numOldLeft = previousBegins[leftClass];
+            const uint64_t numOldRight = previousBegins[rightClass];
+            const uint64_t numNewLeft = previousEnds[leftClass] - numOldLeft;
+            const uint64_t numNewRight = numRight - numOldRight;
+
+            Expression expression;
+            expression.termIndex = termIndex;
+            expression.depth = depth;
+
+            const auto termCandidate = candidate - termOffset;
+            if (termCandidate < numNewLeft * numRight)
+            {
+                expression.left = int(numOldLeft + termCandidate / numRight);
+                expression.right = int(termCandidate % numRight);
+            }
+            else
+            {
+                const auto oldLeftCandidate = termCandidate - numNewLeft * numRight;
+                expression.left = int(oldLeftCandidate / numNewRight);
+                expression.right = int(numOldRight + oldLeftCandidate % numNewRight);
+            }
+
+            expression.hash = Hint::getNodeHash(term.symbol,
+                this->expressions[leftClass][expression.left].hash,
+                this->expressions[rightClass][expression.right].hash);
 
+            result.push_back(expression);
+        }
 
-                const auto randomSubTerm = this->random.pickOne(classPtr->terms);
-                assert(randomSubTerm->childrenIds.size() == 2 || randomSubTerm->childrenIds.empty());
+        return result;
+    }
 
-                // I'm not 100% sure if this is a correct condition,
-                // but hopefully it should work: if we've already added that term at least twice,
-                // and it is an operation (i.e. has more sub-terms),
-                // we're likely to end up in a loop. I guess.
-                const auto subTermLeafId = this->eGraph.termsLookup.at(randomSubTerm);
-                const bool isLoop = !randomSubTerm->childrenIds.empty() &&
-                    expression->usedLeafIds[subTermLeafId] > 1;
+    // returns nothing for the expressions which seem to go in circles
+    Hint::Ptr makeHint(int classIndex, int expressionIndex)
+    {
+        const auto &expression = this->expressions[classIndex][expressionIndex];
+        auto hint = Hint::make(this->arena, this->terms[expression.termIndex].symbol);
+        hint->rootId = this->classIds[classIndex];
 
-                if (isLoop)
+        if (!this->collectExpressions(*hint, hint->rootNode, classIndex, expressionIndex))
+        {
+            return nullptr;
+        }
+
+        // no need to walk the tree again, the enumeration knows these already
+        hint->astDepth = expression.depth;
+        hint->hash = expression.hash;
+        return hint;
+    }
+
+    bool collectExpressions(Hint &hint, Hint::AstNode &astNode, int classIndex, int expressionIndex)
+    {
+        const auto &expression = this->expressions[classIndex][expressionIndex];
+        const auto &term = this->terms[expression.termIndex];
+
+        const auto numUses = ++hint.usedLeafIds[term.leafId];
+        hint.usedSymbols.insert(term.symbol);
+
+        if (term.childrenClasses.empty())
+        {
+            hint.usedTermSymbols.insert(term.symbol);
+            return true;
+        }
+
+        hint.usedOperationSymbols.insert(term.symbol);
+
+        // the same operation node showing up more than twice
+        // is most likely a loop, which makes for an ugly hint
+        if (numUses > 2)
+        {
+            return false;
+        }
+
+        assert(term.childrenClasses.size() == 2);
+        const auto &leftExpression = this->expressions[term.childrenClasses.front()][expression.left];
+        const auto &rightExpression = this->expressions[term.childrenClasses.back()][expression.right];
+
+        astNode.children.reserve(2);
+        astNode.children.emplace_back(this->terms[leftExpression.termIndex].symbol);
+        if (!this->collectExpressions(hint, astNode.children.back(), term.childrenClasses.front(), expression.left))
+        {
+            return false;
+        }
+
+        astNode.children.emplace_back(this->terms[rightExpression.termIndex].symbol);
+        return this->collectExpressions(hint, astNode.children.back(), term.childrenClasses.back(), expression.right);
+    }
+
+    // the enumeration only needs the graph's structure, so it's flattened once per extract()
+    // into plain arrays, where the child classes are indices, not ids to look up
+    void takeSnapshot()
+    {
+        this->terms.clear();
+        this->classTerms.clear();
+        this->classIds.clear();
+
+        this->classIds.reserve(this->eGraph.classes.size());
+        for (const auto &it : this->eGraph.classes)
+        {
+            this->classIds.push_back(it.first);
+        }
+
+        std::sort(this->classIds.begin(), this->classIds.end());
+
+        HashMap<e::ClassId, int> classIndices;
+        for (int i = 0; i < this->classIds.size(); ++i)
+        {
+            classIndices[this->classIds[i]] = i;
+        }
+
+        // class terms are kept in the same order as in the graph
+        this->classTerms.resize(this->classIds.size());
+        for (int i = 0; i < this->classIds.size(); ++i)
+        {
+            for (const auto &term : this->eGraph.classes.at(this->classIds[i])->terms)
+            {
+                assert(term->childrenIds.size() == 2 || term->childrenIds.empty());
+
+                TermInfo termInfo;
+                termInfo.symbol = Alphabet::getId(term->name);
+                termInfo.leafId = this->eGraph.termsLookup.at(term);
+                for (const auto childId : term->childrenIds)
                 {
-                    return false;
+                    termInfo.childrenClasses.push_back(classIndices.at(this->eGraph.find(childId)));
                 }
 
-                parentAstNode.children.push_back(Hint::AstNode(randomSubTerm->name));
-                hasResult = hasResult && this->collectExpressions(expression,
-                    parentAstNode.children.back(), randomSubTerm, subTermLeafId);
+                this->classTerms[i].push_back(int(this->terms.size()));
+                this->terms.push_back(move(termInfo));
             }
         }
-
-        return hasResult;
     }
 
-private:
-
     const e::Graph &eGraph;
 
-    Random random;
+    const uint64_t seed;
+
+    const int maxDepth;
+    const int maxHintsPerClass;
+
+    std::shared_ptr<Arena> arena;
+
+    struct TermInfo final
+    {
+        SymbolId symbol {};
+        e::ClassId leafId = 0;
+        Vector<int> childrenClasses;
+    };
+
+    Vector<TermInfo> terms;
+    Vector<Vector<int>> classTerms;
+    Vector<e::ClassId> classIds;
+
+    Vector<Vector<Expression>> expressions;
+    Vector<uint64_t> numCandidatesPerClass;
 };
@@ -0,0 +1,257 @@
+#pragma once
+
+#include "Common.h"
+
+// Just enough JSON for the line-delimited formats of the tools:
+// writing strings and arrays of strings, and reading flat objects,
+// which is all the quest server's requests are
+
+inline String escapeJson(const String &string)
+{
+    String result;
+    for (const auto c : string)
+    {
+        switch (c)
+        {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (uint8_t(c) < 0x20)
+                {
+                    // the rest of the control characters are not allowed in JSON strings as they are
+                    static const char *hexDigits = "0123456789abcdef";
+                    result += "\\u00";
+                    result += hexDigits[uint8_t(c) >> 4];
+                    result += hexDigits[uint8_t(c) & 0xf];
+                }
+                else
+                {
+                    result += c;
+                }
+        }
+    }
+    return result;
+}
+
+template <typename C>
+String formatJsonArray(const C &strings)
+{
+    String result = "[";
+    for (const auto &string : strings)
+    {
+        result += (result.size() > 1 ? ",\"" : "\"") + escapeJson(string) + "\"";
+    }
+    return result + "]";
+}
+
+// reads an object of strings, numbers and booleans, all returned as strings;
+// returns nothing for anything else, including nested objects and arrays
+inline Optional<HashMap<String, String>> parseJsonObject(const String &json)
+{
+    size_t i = 0;
+
+    const auto skipSpaces = [&]()
+    {
+        while (i < json.size() && (json[i] == ' ' || json[i] == '\t' || json[i] == '\r' || json[i] == '\n'))
+        {
+            i++;
+        }
+    };
+
+    // exactly four hex digits after \u
+    const auto readCodeUnit = [&](uint32_t &outCode)
+    {
+        if (i + 4 >= json.size())
+        {
+            return false;
+        }
+
+        outCode = 0;
+        for (int digit = 0; digit < 4; ++digit)
+        {
+            const auto c = json[++i];
+            const auto value = (c >= '0' && c <= '9') ? c - '0' :
+                (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+
+            if (value < 0)
+            {
+                return false;
+            }
+
+            outCode = (outCode << 4) | uint32_t(value);
+        }
+
+        return true;
+    };
+
+    const auto readString = [&](String &outString)
+    {
+        if (i >= json.size() || json[i] != '"')
+        {
+            return false;
+        }
+
+        for (i++; i < json.size(); ++i)
+        {
+            if (json[i] == '"')
+            {
+                i++;
+                return true;
+            }
+
+            if (json[i] != '\\')
+            {
+                outString += json[i];
+                continue;
+            }
+
+            if (++i >= json.size())
+            {
+                return false;
+            }
+
+            switch (json[i])
+            {
+                case '"': outString += '"'; break;
+                case '\\': outString += '\\'; break;
+                case '/': outString += '/'; break;
+                case 'b': outString += '\b'; break;
+                case 'f': outString += '\f'; break;
+                case 'n': outString += '\n'; break;
+                case 'r': outString += '\r'; break;
+                case 't': outString += '\t'; break;
+                case 'u':
+                {
+                    uint32_t code = 0;
+                    if (!readCodeUnit(code))
+                    {
+                        return false;
+                    }
+
+                    // the characters outside of the basic plane come as pairs of surrogates
+                    if (code >= 0xd800 && code < 0xdc00)
+                    {
+                        uint32_t lowSurrogate = 0;
+                        if (i + 2 >= json.size() || json[i + 1] != '\\' || json[i + 2] != 'u')
+                        {
+                            return false;
+                        }
+
+                        i += 2;
+                        if (!readCodeUnit(lowSurrogate) || lowSurrogate < 0xdc00 || lowSurrogate >= 0xe000)
+                        {
+                            return false;
+                        }
+
+                        code = 0x10000 + ((code - 0xd800) << 10) + (lowSurrogate - 0xdc00);
+                    }
+                    else if (code >= 0xdc00 && code < 0xe000)
+                    {
+                        return false;
+                    }
+
+                    if (code < 0x80)
+                    {
+                        outString += char(code);
+                    }
+                    else if (code < 0x800)
+                    {
+                        outString += char(0xc0 | (code >> 6));
+                        outString += char(0x80 | (code & 0x3f));
+                    }
+                    else if (code < 0x10000)
+                    {
+                        outString += char(0xe0 | (code >> 12));
+                        outString += char(0x80 | ((code >> 6) & 0x3f));
+                        outString += char(0x80 | (code & 0x3f));
+                    }
+                    else
+                    {
+                        outString += char(0xf0 | (code >> 18));
+                        outString += char(0x80 | ((code >> 12) & 0x3f));
+                        outString += char(0x80 | ((code >> 6) & 0x3f));
+                        outString += char(0x80 | (code & 0x3f));
+                    }
+                    break;
+                }
+                default: return false;
+            }
+        }
+
+        return false;
+    };
+
+    HashMap<String, String> result;
+
+    skipSpaces();
+    if (i >= json.size() || json[i++] != '{')
+    {
+        return {};
+    }
+
+    skipSpaces();
+    if (i < json.size() && json[i] == '}')
+    {
+        return result;
+    }
+
+    while (true)
+    {
+        String key;
+        skipSpaces();
+        if (!readString(key))
+        {
+            return {};
+        }
+
+        skipSpaces();
+        if (i >= json.size() || json[i++] != ':')
+        {
+            return {};
+        }
+
+        skipSpaces();
+        String value;
+        if (i < json.size() && json[i] == '"')
+        {
+            if (!readString(value))
+            {
+                return {};
+            }
+        }
+        else
+        {
+            while (i < json.size() && json[i] != ',' && json[i] != '}' && json[i] != ' ')
+            {
+                value += json[i++];
+            }
+
+            if (value.empty() || value.front() == '{' || value.front() == '[')
+            {
+                return {};
+            }
+        }
+
+        result[key] = move(value);
+
+        skipSpaces();
+        if (i >= json.size())
+        {
+            return {};
+        }
+
+        if (json[i] == '}')
+        {
+            return result;
+        }
+
+        if (json[i++] != ',')
+        {
+            return {};
+        }
+    }
+}
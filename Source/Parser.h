@@ -151,6 +151,33 @@ e::RewriteRule makeRewriteRule(const std::string &expression, const std::string
     return makeRewriteRule(*node, customOperationSymbol);
 }
 
+// does the same as customOperationSymbol above, but for an already parsed
+// pattern, so that a template can be parsed once and reused for any operation
+e::Pattern replaceOperationSymbol(const e::Pattern &pattern, const e::Symbol &operationSymbol)
+{
+    if (pattern.term == nullptr)
+    {
+        return pattern; // pattern variables are left as they are
+    }
+
+    e::PatternTerm term;
+    term.name = pattern.term->arguments.empty() ? pattern.term->name : operationSymbol;
+    for (const auto &argument : pattern.term->arguments)
+    {
+        term.arguments.push_back(replaceOperationSymbol(argument, operationSymbol));
+    }
+
+    return term;
+}
+
+e::RewriteRule replaceOperationSymbol(const e::RewriteRule &ruleTemplate, const e::Symbol &operationSymbol)
+{
+    e::RewriteRule rule;
+    rule.leftHand = replaceOperationSymbol(ruleTemplate.leftHand, operationSymbol);
+    rule.rightHand = replaceOperationSymbol(ruleTemplate.rightHand, operationSymbol);
+    return rule;
+}
+
 e::Pattern makePattern(const std::string &expression)
 {
     using namespace tao::pegtl;
@@ -159,14 +186,17 @@ e::Pattern makePattern(const std::string &expression)
     return makePattern(*node, {});
 }
 
-String formatPatternTerm(const e::PatternTerm &patternTerm, bool wrapWithBrackets = true)
+String formatPatternTerm(const e::PatternTerm &patternTerm, bool wrapWithBrackets = true,
+    const std::string &openingBracket = "(", const std::string &closingBracket = ")")
 {
     // we only generate binary operators
     if (patternTerm.arguments.size() == 2)
     {
-        const auto result = formatPatternTerm(*patternTerm.arguments.front().term) +
-            " " + patternTerm.name + " " + formatPatternTerm(*patternTerm.arguments.back().term);
-        return wrapWithBrackets ? ("(" + result + ")") : result;
+        const auto result =
+            formatPatternTerm(*patternTerm.arguments.front().term, true, openingBracket, closingBracket) +
+            " " + patternTerm.name + " " +
+            formatPatternTerm(*patternTerm.arguments.back().term, true, openingBracket, closingBracket);
+        return wrapWithBrackets ? (openingBracket + result + closingBracket) : result;
     }
 
     return patternTerm.name;
@@ -0,0 +1,240 @@
+
+#include "Common.h"
+#include "AlienAlgebra.h"
+#include "Parser.h"
+#include "QuestGenerator.h"
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+// Checks how the properties behave when saturated, so that a new property
+// doesn't have to be checked by hand for infinite rewriting (see AlienAlgebra.h):
+// each property alone is saturated on a canonical graph of all small expressions,
+// and each combination the generator can pick is generated with several fixed seeds;
+// the combinations that blow up the e-graph every time are listed;
+// usage: compatibility [--seeds N] [--seed S] [--threads T] [--table table.tsv]
+
+struct Outcome final
+{
+    int numAttempts = 0;
+    int numSucceeded = 0;
+    int numExplosions = 0;
+    int maxRewritePasses = 0;
+    double maxGrowth = 0.0;
+
+    void add(const GenerationStats &stats, FailureReason failureReason)
+    {
+        this->numAttempts++;
+        this->numSucceeded += int(failureReason == FailureReason::None);
+        this->numExplosions += int(failureReason == FailureReason::GraphExplosion);
+        this->maxRewritePasses = std::max(this->maxRewritePasses, int(stats.rewritePasses.size()));
+        if (stats.initialGraphSize.numClasses > 0)
+        {
+            this->maxGrowth = std::max(this->maxGrowth,
+                double(stats.peakGraphSize.numClasses) / stats.initialGraphSize.numClasses);
+        }
+    }
+
+    // never reached a fixpoint
+    bool isLooping() const
+    {
+        return this->maxRewritePasses >= QuestGenerator::maxRewritePasses;
+    }
+
+    bool isIncompatible() const
+    {
+        return this->numAttempts > 0 && this->numExplosions == this->numAttempts;
+    }
+};
+
+// a, b, c and all the expressions of one and two operations over them
+Outcome checkProperty(const OperationProperty &property)
+{
+    const e::Symbol operationSymbol = ".";
+    const auto rule = Parser::makeRewriteRule(property.rewriteTemplate, operationSymbol);
+
+    e::Graph eGraph;
+
+    Vector<ClassId> terms;
+    for (const auto &name : {"a", "b", "c"})
+    {
+        terms.push_back(eGraph.addTerm(name));
+    }
+
+    for (const auto x : terms)
+    {
+        for (const auto y : terms)
+        {
+            const auto xy = eGraph.addOperation(operationSymbol, {x, y});
+            for (const auto z : terms)
+            {
+                eGraph.addOperation(operationSymbol, {xy, z});
+                eGraph.addOperation(operationSymbol, {z, xy});
+            }
+        }
+    }
+
+    const auto initialNumClasses = eGraph.classes.size();
+
+    QuestGenerator generator(eGraph, 0);
+    const auto saturated = generator.saturate({rule}, initialNumClasses * 5);
+
+    auto stats = generator.getStats();
+    stats.initialGraphSize = {int(initialNumClasses), int(eGraph.termsLookup.size())};
+
+    Outcome outcome;
+    outcome.add(stats, saturated ? FailureReason::None : FailureReason::GraphExplosion);
+    return outcome;
+}
+
+// all combinations of properties the generator can pick, one per level, without repeats
+void collectCombinations(Vector<int> &combination, Vector<Vector<int>> &outCombinations)
+{
+    const auto levelNumber = int(combination.size());
+    if (levelNumber == QuestGenerator::numLevels)
+    {
+        outCombinations.push_back(combination);
+        return;
+    }
+
+    for (int i = 0; i < AlienAlgebra::allProperties.size(); ++i)
+    {
+        if (contains(AlienAlgebra::allProperties[i].levels, levelNumber) &&
+            std::find(combination.begin(), combination.end(), i) == combination.end())
+        {
+            combination.push_back(i);
+            collectCombinations(combination, outCombinations);
+            combination.pop_back();
+        }
+    }
+}
+
+String formatCombination(const Vector<int> &combination, const String &separator)
+{
+    String result;
+    for (int i = 0; i < combination.size(); ++i)
+    {
+        result += (i > 0 ? separator : "") + std::to_string(combination[i]);
+    }
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    HashMap<String, String> options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        options[argv[i]] = argv[i + 1];
+    }
+
+    const auto numSeeds = contains(options, "--seeds") ? std::stoi(options.at("--seeds")) : 3;
+    const auto seed = contains(options, "--seed") ? std::stoull(options.at("--seed")) : 1;
+    const auto numThreads = std::max(1, contains(options, "--threads") ?
+        std::stoi(options.at("--threads")) : int(std::thread::hardware_concurrency()));
+
+    std::cout << std::left << std::setw(48) << "property" << std::right
+              << std::setw(8) << "passes" << std::setw(10) << "growth" << std::endl;
+
+    bool hasLoopingProperties = false;
+    for (const auto &property : AlienAlgebra::allProperties)
+    {
+        const auto outcome = checkProperty(property);
+        hasLoopingProperties = hasLoopingProperties || outcome.isLooping() || outcome.isIncompatible();
+
+        std::cout << std::left << std::setw(48) << property.rewriteTemplate << std::right
+                  << std::setw(8) << outcome.maxRewritePasses
+                  << std::setw(10) << std::fixed << std::setprecision(2) << outcome.maxGrowth
+                  << (outcome.isIncompatible() ? "  blows up" : (outcome.isLooping() ? "  loops" : ""))
+                  << std::endl;
+    }
+
+    Vector<int> combination;
+    Vector<Vector<int>> combinations;
+    collectCombinations(combination, combinations);
+
+    // each worker takes the next combination, and writes only its own outcome
+    Vector<Outcome> outcomes(combinations.size());
+    std::atomic<int> nextCombination {0};
+
+    const auto runWorker = [&]()
+    {
+        while (true)
+        {
+            const auto index = nextCombination.fetch_add(1);
+            if (index >= combinations.size())
+            {
+                return;
+            }
+
+            for (int i = 0; i < numSeeds; ++i)
+            {
+                e::Graph eGraph;
+                Vector<Level> levels;
+
+                QuestGenerator generator(eGraph, Random::mixSeed(seed, i));
+                generator.forceProperties(combinations[index]);
+                generator.tryGenerate(levels);
+                outcomes[index].add(generator.getStats(), generator.getFailureReason());
+            }
+        }
+    };
+
+    Vector<std::thread> workers;
+    for (int i = 0; i < numThreads; ++i)
+    {
+        workers.emplace_back(runWorker);
+    }
+
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    std::ofstream table;
+    if (contains(options, "--table"))
+    {
+        table.open(options.at("--table"));
+        if (!table.is_open())
+        {
+            std::cerr << "Cannot open " << options.at("--table") << std::endl;
+            return 1;
+        }
+
+        table << "properties\tattempts\tsucceeded\texplosions\tpasses\tgrowth\n";
+    }
+
+    int numSucceeded = 0;
+    int numAttempts = 0;
+    Vector<Vector<int>> incompatibleCombinations;
+    for (int i = 0; i < combinations.size(); ++i)
+    {
+        const auto &outcome = outcomes[i];
+        numSucceeded += outcome.numSucceeded;
+        numAttempts += outcome.numAttempts;
+
+        if (outcome.isIncompatible())
+        {
+            incompatibleCombinations.push_back(combinations[i]);
+        }
+
+        if (table.is_open())
+        {
+            table << formatCombination(combinations[i], ",") << '\t' << outcome.numAttempts << '\t'
+                  << outcome.numSucceeded << '\t' << outcome.numExplosions << '\t'
+                  << outcome.maxRewritePasses << '\t' << outcome.maxGrowth << '\n';
+        }
+    }
+
+    std::cout << combinations.size() << " combinations, " << numSucceeded << " of " << numAttempts
+              << " attempts succeeded, " << incompatibleCombinations.size() << " always blow up" << std::endl;
+
+    // the ones that blow up with every seed tried; other seeds might still make quests out of them
+    for (const auto &incompatibleCombination : incompatibleCombinations)
+    {
+        std::cout << "  " << formatCombination(incompatibleCombination, ", ") << std::endl;
+    }
+
+    return (hasLoopingProperties || !incompatibleCombinations.empty()) ? 2 : 0;
+}
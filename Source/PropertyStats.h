@@ -0,0 +1,158 @@
+#pragma once
+
+#include "Common.h"
+#include "AlienAlgebra.h"
+#include "GenerationStats.h"
+#include "Json.h"
+
+#if !WEB_CLIENT
+#include <mutex>
+#endif
+
+// The outcomes of the generation attempts by the properties they have picked:
+// how often each combination of properties fails, and why,
+// and how often each property succeeds on each level, which the generator
+// can use to prefer the properties that actually make quests;
+// one instance is meant to be shared by the generators on all threads
+
+class PropertyStats final
+{
+public:
+
+    // the adaptive selection depends on all the attempts made before,
+    // so a quest id alone no longer reproduces the quest
+    explicit PropertyStats(bool isAdaptive) :
+        isAdaptive(isAdaptive) {}
+
+    const bool isAdaptive;
+
+    // the property indices are in AlienAlgebra::allProperties, one per level
+    void add(const Vector<int> &propertyIndices, FailureReason reason)
+    {
+        // says nothing about the properties
+        if (reason == FailureReason::Cancelled)
+        {
+            return;
+        }
+
+#if !WEB_CLIENT
+        std::lock_guard<std::mutex> lock(this->mutex);
+#endif
+
+        this->combinations[propertyIndices].add(reason);
+
+        if (this->levels.size() < propertyIndices.size())
+        {
+            this->levels.resize(propertyIndices.size(),
+                Vector<Counters>(AlienAlgebra::allProperties.size()));
+        }
+
+        for (int i = 0; i < propertyIndices.size(); ++i)
+        {
+            this->levels[i][propertyIndices[i]].add(reason);
+        }
+    }
+
+    // the success rates of the properties on a level, by the rule of succession,
+    // so that the properties not tried yet still have a chance
+    Vector<double> getWeights(int levelNumber, const Vector<int> &propertyIndices) const
+    {
+#if !WEB_CLIENT
+        std::lock_guard<std::mutex> lock(this->mutex);
+#endif
+
+        Vector<double> result;
+        result.reserve(propertyIndices.size());
+        for (const auto propertyIndex : propertyIndices)
+        {
+            Counters counters;
+            if (levelNumber < this->levels.size())
+            {
+                counters = this->levels[levelNumber][propertyIndex];
+            }
+
+            const auto numSuccesses = counters.numAttempts - counters.getNumFailures();
+            result.push_back((numSuccesses + 1.0) / (counters.numAttempts + 2.0));
+        }
+
+        return result;
+    }
+
+    // the combinations that have failed at least once, in the order of their indices
+    String toJson() const
+    {
+#if !WEB_CLIENT
+        std::lock_guard<std::mutex> lock(this->mutex);
+#endif
+
+        String result = "{\"combinations\":[";
+        bool isFirst = true;
+        for (const auto &it : this->combinations)
+        {
+            if (it.second.getNumFailures() == 0)
+            {
+                continue;
+            }
+
+            result += (isFirst ? "" : ",");
+            isFirst = false;
+
+            result += "{\"properties\":[";
+            for (int i = 0; i < it.first.size(); ++i)
+            {
+                result += (i > 0 ? ",\"" : "\"") +
+                    escapeJson(AlienAlgebra::allProperties[it.first[i]].rewriteTemplate) + "\"";
+            }
+
+            result += "],\"numAttempts\":" + std::to_string(it.second.numAttempts);
+            for (int i = 1; i < numFailureReasons; ++i)
+            {
+                if (it.second.numFailuresByReason[i] > 0)
+                {
+                    result += ",\"" + String(getFailureReasonName(FailureReason(i))) + "\":" +
+                        std::to_string(it.second.numFailuresByReason[i]);
+                }
+            }
+
+            result += "}";
+        }
+
+        return result + "]}";
+    }
+
+private:
+
+    struct Counters final
+    {
+        int numAttempts = 0;
+        std::array<int, numFailureReasons> numFailuresByReason {};
+
+        void add(FailureReason reason)
+        {
+            this->numAttempts++;
+            if (reason != FailureReason::None)
+            {
+                this->numFailuresByReason[int(reason)]++;
+            }
+        }
+
+        int getNumFailures() const
+        {
+            int result = 0;
+            for (const auto numFailures : this->numFailuresByReason)
+            {
+                result += numFailures;
+            }
+            return result;
+        }
+    };
+
+    SortedMap<Vector<int>, Counters> combinations;
+
+    // by level, then by property index
+    Vector<Vector<Counters>> levels;
+
+#if !WEB_CLIENT
+    mutable std::mutex mutex;
+#endif
+};
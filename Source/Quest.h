@@ -0,0 +1,491 @@
+#pragma once
+
+#include "Common.h"
+#include "QuestGenerator.h"
+#include "Parser.h"
+#include "EGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+// A compact, self-contained snapshot of a generated quest:
+// the strings shown on each level and the equivalence classes
+// needed to check the answers, but none of the hints
+// and none of the e-graph bookkeeping they were extracted from.
+//
+// Answers are identified by structural hashes of their symbol names,
+// and each level carries the hashes of all valid answers up to
+// Quest::maxPrecomputedAnswerSize nodes (plus the valid suggestions),
+// so most checks are a single lookup; only typed answers larger than that
+// still have to be matched against the classes
+
+struct QuestLevel final
+{
+    String hint;
+    String question;
+    Vector<String> suggestions;
+
+    // an index in Quest::classes
+    int questionClass = 0;
+
+    uint64_t questionHash = 0;
+    Vector<uint64_t> suggestionHashes;
+    HashSet<uint64_t> validAnswerHashes;
+};
+
+struct Quest final
+{
+    struct Node final
+    {
+        Symbol name;
+        Vector<int> childrenClasses;
+    };
+
+    struct Class final
+    {
+        Vector<Node> nodes;
+    };
+
+    QuestId id = 0;
+
+    Vector<QuestLevel> levels;
+    Vector<Class> classes;
+
+    // the names the hashes were computed over, by the current names of the symbols,
+    // if they were renamed after that (see renameSymbols); empty otherwise
+    HashMap<Symbol, Symbol> hashedNames;
+
+    // in nodes, i.e. terms and operations; the number of expressions grows
+    // very fast with it, and longer answers are rarely typed anyway
+    static constexpr auto maxPrecomputedAnswerSize = 11;
+
+    static Quest fromGenerated(QuestId questId, const e::Graph &eGraph, const Vector<Level> &levels)
+    {
+        Quest quest;
+        quest.id = questId;
+
+        // the classes are renumbered densely, in the order of their ids
+        Vector<ClassId> classIds;
+        classIds.reserve(eGraph.classes.size());
+        for (const auto &it : eGraph.classes)
+        {
+            classIds.push_back(it.first);
+        }
+
+        std::sort(classIds.begin(), classIds.end());
+
+        HashMap<ClassId, int> classIndices;
+        for (int i = 0; i < classIds.size(); ++i)
+        {
+            classIndices[classIds[i]] = i;
+        }
+
+        quest.classes.resize(classIds.size());
+        for (int i = 0; i < classIds.size(); ++i)
+        {
+            for (const auto &term : eGraph.classes.at(classIds[i])->terms)
+            {
+                Node node;
+                node.name = term->name;
+                for (const auto childId : term->childrenIds)
+                {
+                    node.childrenClasses.push_back(classIndices.at(eGraph.find(childId)));
+                }
+
+                quest.classes[i].nodes.push_back(move(node));
+            }
+        }
+
+        const auto answerHashesByClass = quest.collectAnswerHashes();
+
+        for (const auto &level : levels)
+        {
+            QuestLevel questLevel;
+            questLevel.hint = level.getFormattedHint();
+            questLevel.question = level.question->getFormatted();
+            questLevel.questionClass = classIndices.at(eGraph.find(level.question->rootId));
+            questLevel.suggestions = level.suggestions;
+
+            questLevel.questionHash = Quest::getExpressionHash(questLevel.question).first;
+
+            for (const auto &sizeHashes : answerHashesByClass[questLevel.questionClass])
+            {
+                questLevel.validAnswerHashes.insert(sizeHashes.begin(), sizeHashes.end());
+            }
+
+            // the suggestions which are too large to be precomputed are matched once here,
+            // so that clicking any of them is always a lookup
+            for (const auto &suggestion : questLevel.suggestions)
+            {
+                const auto hashAndSize = Quest::getExpressionHash(suggestion);
+                questLevel.suggestionHashes.push_back(hashAndSize.first);
+
+                if (hashAndSize.second > Quest::maxPrecomputedAnswerSize &&
+                    quest.matchExpression(suggestion, questLevel.questionClass))
+                {
+                    questLevel.validAnswerHashes.insert(hashAndSize.first);
+                }
+            }
+
+            quest.levels.push_back(move(questLevel));
+        }
+
+        return quest;
+    }
+
+    // gives the symbols new names everywhere, in the classes and in the level strings,
+    // which makes a quest that looks different, but plays the same (see QuestSkeletonCache);
+    // the hashes are kept as they are, and the answers are hashed with the old names instead,
+    // so this costs as much as formatting the strings; the names not in the map are kept,
+    // and no two symbols should end up with the same name
+    void renameSymbols(const HashMap<Symbol, Symbol> &newNames)
+    {
+        HashMap<Symbol, Symbol> hashedNames;
+        for (auto &questClass : this->classes)
+        {
+            for (auto &node : questClass.nodes)
+            {
+                const auto oldName = node.name;
+                const auto newName = newNames.find(oldName);
+                if (newName != newNames.end())
+                {
+                    node.name = newName->second;
+                }
+
+                const auto hashedName = this->hashedNames.find(oldName);
+                hashedNames[node.name] = (hashedName != this->hashedNames.end()) ? hashedName->second : oldName;
+            }
+        }
+
+        this->hashedNames = move(hashedNames);
+
+        for (auto &level : this->levels)
+        {
+            level.hint = Quest::renameSymbolsInString(level.hint, newNames);
+            level.question = Quest::renameSymbolsInString(level.question, newNames);
+
+            for (auto &suggestion : level.suggestions)
+            {
+                suggestion = Quest::renameSymbolsInString(suggestion, newNames);
+            }
+        }
+    }
+
+    // the hash of an answer, comparable with the ones of the levels
+    uint64_t getAnswerHash(const PatternTerm &patternTerm, int &outSize) const
+    {
+        return Quest::getPatternTermHash(patternTerm, outSize, nullptr,
+            this->hashedNames.empty() ? nullptr : &this->hashedNames);
+    }
+
+    bool isValidSuggestion(int levelNumber, int suggestionIndex) const
+    {
+        assert(levelNumber >= 0 && levelNumber < this->levels.size());
+        const auto &level = this->levels[levelNumber];
+        assert(suggestionIndex >= 0 && suggestionIndex < level.suggestionHashes.size());
+        return this->isValidAnswerHash(level, level.suggestionHashes[suggestionIndex]);
+    }
+
+    // typed answers are checked with AnswerGrader, which parses them
+    // and falls back to matching for the ones too large to be precomputed
+    bool isValidAnswerHash(int levelNumber, uint64_t hash) const
+    {
+        assert(levelNumber >= 0 && levelNumber < this->levels.size());
+        return this->isValidAnswerHash(this->levels[levelNumber], hash);
+    }
+
+    // a sanity check before putting a quest into a pool:
+    // every level should be passable by clicking one of the suggestions
+    bool hasValidSuggestions() const
+    {
+        for (int i = 0; i < this->levels.size(); ++i)
+        {
+            bool hasValidSuggestion = false;
+            for (int j = 0; j < this->levels[i].suggestionHashes.size(); ++j)
+            {
+                hasValidSuggestion = hasValidSuggestion || this->isValidSuggestion(i, j);
+            }
+
+            if (!hasValidSuggestion)
+            {
+                return false;
+            }
+        }
+
+        return !this->levels.empty();
+    }
+
+    // the same as Hint's hash, but computed over symbol names instead of symbol ids,
+    // so that it stays valid for the saved quests even if the alphabet changes
+    static uint64_t getNodeHash(const Symbol &name, const Vector<uint64_t> &childrenHashes)
+    {
+        auto hash = Hashing::combine(Hashing::initialValue, name);
+        for (const auto childHash : childrenHashes)
+        {
+            hash = Hashing::combine(hash, childHash);
+        }
+        return hash;
+    }
+
+    // also counts the nodes, and optionally collects the hashes of all sub-terms;
+    // throws if the expression has any pattern variables;
+    // with the renamed symbols, the names are replaced with the ones in the map,
+    // and the names not in the map, e.g. the ones before renaming, never match anything
+    static uint64_t getPatternTermHash(const PatternTerm &patternTerm, int &outSize,
+        HashMap<const PatternTerm *, uint64_t> *outSubTermHashes = nullptr,
+        const HashMap<Symbol, Symbol> *hashedNames = nullptr)
+    {
+        outSize++;
+
+        Vector<uint64_t> childrenHashes;
+        for (const auto &argument : patternTerm.arguments)
+        {
+            if (argument.term == nullptr)
+            {
+                throw std::invalid_argument("Pattern variables are not allowed in answers");
+            }
+
+            childrenHashes.push_back(Quest::getPatternTermHash(*argument.term,
+                outSize, outSubTermHashes, hashedNames));
+        }
+
+        uint64_t hash = 0;
+        if (hashedNames == nullptr)
+        {
+            hash = Quest::getNodeHash(patternTerm.name, childrenHashes);
+        }
+        else
+        {
+            const auto found = hashedNames->find(patternTerm.name);
+            hash = Quest::getNodeHash((found != hashedNames->end()) ?
+                found->second : (String(1, '\0') + patternTerm.name), childrenHashes);
+        }
+
+        if (outSubTermHashes != nullptr)
+        {
+            (*outSubTermHashes)[&patternTerm] = hash;
+        }
+
+        return hash;
+    }
+
+    static std::pair<uint64_t, int> getExpressionHash(const String &expression)
+    {
+        const auto pattern = Parser::makePattern(expression);
+        assert(pattern.term != nullptr);
+
+        int size = 0;
+        const auto hash = Quest::getPatternTermHash(*pattern.term, size);
+        return {hash, size};
+    }
+
+private:
+
+    // the question itself shouldn't be accepted as an answer
+    bool isValidAnswerHash(const QuestLevel &level, uint64_t hash) const
+    {
+        return hash != level.questionHash && contains(level.validAnswerHashes, hash);
+    }
+
+    // the formatted expressions always have spaces between the symbols,
+    // and only the brackets can stick to them, so they don't need to be parsed
+    static String renameSymbolsInString(const String &string, const HashMap<Symbol, Symbol> &newNames)
+    {
+        const auto &openingBracket = Symbols::openingBracket;
+        const auto &closingBracket = Symbols::closingBracket;
+
+        String result;
+        result.reserve(string.size());
+
+        size_t tokenBegin = 0;
+        while (tokenBegin <= string.size())
+        {
+            auto tokenEnd = string.find(' ', tokenBegin);
+            tokenEnd = (tokenEnd == String::npos) ? string.size() : tokenEnd;
+
+            auto nameBegin = tokenBegin;
+            while (string.compare(nameBegin, openingBracket.size(), openingBracket) == 0)
+            {
+                nameBegin += openingBracket.size();
+            }
+
+            auto nameEnd = tokenEnd;
+            while (nameEnd >= nameBegin + closingBracket.size() &&
+                string.compare(nameEnd - closingBracket.size(), closingBracket.size(), closingBracket) == 0)
+            {
+                nameEnd -= closingBracket.size();
+            }
+
+            const auto found = newNames.find(string.substr(nameBegin, nameEnd - nameBegin));
+
+            result.append(string, tokenBegin, nameBegin - tokenBegin);
+            if (found != newNames.end())
+            {
+                result += found->second;
+            }
+            else
+            {
+                result.append(string, nameBegin, nameEnd - nameBegin);
+            }
+            result.append(string, nameEnd, tokenEnd - nameEnd);
+
+            if (tokenEnd < string.size())
+            {
+                result += ' ';
+            }
+
+            tokenBegin = tokenEnd + 1;
+        }
+
+        return result;
+    }
+
+    bool matchExpression(const String &expression, int classIndex) const
+    {
+        const auto pattern = Parser::makePattern(expression);
+        assert(pattern.term != nullptr);
+        PatternMatcher matcher(*this);
+        return matcher.match(*pattern.term, classIndex);
+    }
+
+    // the hashes of all expressions of each class, grouped by the number of nodes,
+    // built bottom-up: an operation of size n combines its children's expressions
+    // of all sizes that add up to n - 1 (only the odd sizes exist, since all operations are binary)
+    Vector<Vector<Vector<uint64_t>>> collectAnswerHashes() const
+    {
+        const auto maxSize = Quest::maxPrecomputedAnswerSize;
+        Vector<Vector<Vector<uint64_t>>> result(this->classes.size(),
+            Vector<Vector<uint64_t>>(maxSize + 1));
+
+        for (int size = 1; size <= maxSize; size += 2)
+        {
+            for (int classIndex = 0; classIndex < this->classes.size(); ++classIndex)
+            {
+                HashSet<uint64_t> hashes;
+                for (const auto &node : this->classes[classIndex].nodes)
+                {
+                    if (node.childrenClasses.empty())
+                    {
+                        if (size == 1)
+                        {
+                            hashes.insert(Quest::getNodeHash(node.name, {}));
+                        }
+
+                        continue;
+                    }
+
+                    assert(node.childrenClasses.size() == 2);
+                    for (int leftSize = 1; leftSize < size - 1; leftSize += 2)
+                    {
+                        const auto rightSize = size - 1 - leftSize;
+                        for (const auto leftHash : result[node.childrenClasses.front()][leftSize])
+                        {
+                            for (const auto rightHash : result[node.childrenClasses.back()][rightSize])
+                            {
+                                hashes.insert(Quest::getNodeHash(node.name, {leftHash, rightHash}));
+                            }
+                        }
+                    }
+                }
+
+                result[classIndex][size].assign(hashes.begin(), hashes.end());
+            }
+        }
+
+        return result;
+    }
+
+public:
+
+    // checks if a parsed expression is one of the expressions of a class;
+    // the same sub-expression is often checked against the same class
+    // many times, when different nodes share children classes, or when
+    // many answers are checked at once, so the results are remembered
+    // for each (sub-expression hash, class) pair, up to a limit
+    class PatternMatcher final
+    {
+    public:
+
+        explicit PatternMatcher(const Quest &quest) :
+            quest(quest) {}
+
+        bool match(const PatternTerm &patternTerm, int classIndex)
+        {
+            // forgotten between the matches, not in the middle of one
+            if (this->results.size() >= PatternMatcher::maxNumResults)
+            {
+                this->results.clear();
+            }
+
+            this->subTermHashes.clear();
+
+            int size = 0;
+            Quest::getPatternTermHash(patternTerm, size, &this->subTermHashes);
+
+            return this->matchSubTerm(patternTerm, classIndex);
+        }
+
+    private:
+
+        bool matchSubTerm(const PatternTerm &patternTerm, int classIndex)
+        {
+            assert(classIndex >= 0 && classIndex < this->quest.classes.size());
+
+            const auto key = std::make_pair(this->subTermHashes.at(&patternTerm), classIndex);
+            const auto found = this->results.find(key);
+            if (found != this->results.end())
+            {
+                return found->second;
+            }
+
+            const auto result = this->matchNodes(patternTerm, classIndex);
+            this->results[key] = result;
+            return result;
+        }
+
+        bool matchNodes(const PatternTerm &patternTerm, int classIndex)
+        {
+            for (const auto &node : this->quest.classes[classIndex].nodes)
+            {
+                if (node.name != patternTerm.name ||
+                    node.childrenClasses.size() != patternTerm.arguments.size())
+                {
+                    continue;
+                }
+
+                bool childrenMatch = true;
+                for (int i = 0; i < patternTerm.arguments.size() && childrenMatch; ++i)
+                {
+                    assert(patternTerm.arguments[i].term.get() != nullptr);
+                    childrenMatch = this->matchSubTerm(*patternTerm.arguments[i].term, node.childrenClasses[i]);
+                }
+
+                if (childrenMatch)
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        const Quest &quest;
+
+        static constexpr size_t maxNumResults = 256 * 1024;
+
+        // of the expression being matched
+        HashMap<const PatternTerm *, uint64_t> subTermHashes;
+
+        // the hash of the key only picks the bucket, the keys themselves are compared in full
+        struct ResultKeyHash final
+        {
+            size_t operator()(const std::pair<uint64_t, int> &key) const noexcept
+            {
+                return size_t(Hashing::combine(key.first, uint64_t(key.second)));
+            }
+        };
+
+        HashMap<std::pair<uint64_t, int>, bool, ResultKeyHash> results;
+    };
+};
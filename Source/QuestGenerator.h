@@ -2,14 +2,31 @@
 
 #include "HintsExtractor.h"
 #include "AlienAlgebra.h"
+#include "Alphabet.h"
+#include "GenerationStats.h"
+#include "PropertyStats.h"
 #include "Parser.h"
 #include "EGraph.h"
 
+#include <algorithm>
+#include <functional>
+
+#if !WEB_CLIENT
+#include <atomic>
+#include <climits>
+#include <mutex>
+#include <thread>
+#endif
+
 using e::ClassId;
 using e::PatternTerm;
 using e::RewriteRule;
 using e::Symbol;
 
+// the seed the whole quest is generated from,
+// so the same id always gives the same quest
+using QuestId = uint64_t;
+
 struct Level final
 {
     Hint::Ptr hintLeftHand;
@@ -17,53 +34,279 @@ struct Level final
 
     String getFormattedHint()  const noexcept
     {
-        return this->hintLeftHand->formatted +  " " + Symbols::equalsSign + " " + this->hintRightHand->formatted;
+        return this->hintLeftHand->getFormatted() +  " " + Symbols::equalsSign + " " + this->hintRightHand->getFormatted();
     }
 
     Vector<Hint::Ptr> allUsedExpressions;
-    HashMap<ClassId, Vector<Hint::Ptr>> allUsedExpressionsByClass;
+    SortedMap<ClassId, Vector<Hint::Ptr>> allUsedExpressionsByClass;
 
-    HashSet<Symbol> allKnownTerms;
-    HashSet<Symbol> allKnownOperations;
+    SymbolSet allKnownTerms;
+    SymbolSet allKnownOperations;
 
     Hint::Ptr question;
 
-    HashSet<String> answers;
-    HashSet<String> allTermSymbolsInAnswers;
-    HashSet<String> allOperationSymbolsInAnswers;
+    // both are unique by their hashes
+    Vector<Hint::Ptr> answers;
+    SymbolSet allTermSymbolsInAnswers;
+    SymbolSet allOperationSymbolsInAnswers;
 
-    HashSet<String> wrongAnswers;
+    Vector<Hint::Ptr> wrongAnswers;
 
     Vector<String> suggestions;
 
-    Symbol operation;
+    SymbolId operation {};
 };
 
 struct QuestGenerator final
 {
-    QuestGenerator(e::Graph &eGraph, Random &random) :
-        eGraph(eGraph), random(random) {}
+    // returns true if the attempt is no longer needed,
+    // checked between the expensive steps of generation
+    using CancellationCheck = std::function<bool()>;
 
-    bool tryGenerate(Vector<Level> &outLevels)
+    QuestGenerator(e::Graph &eGraph, uint64_t seed, CancellationCheck isCancelled = {}) :
+        eGraph(eGraph), random(seed), isCancelled(move(isCancelled)),
+        arena(std::make_shared<Arena>(QuestGenerator::arenaBlockSize)) {}
+
+    static constexpr auto numLevels = 4;
+
+    // the upper bound of saturation, in case some rules never reach a fixpoint
+    static constexpr auto maxRewritePasses = 32;
+
+    // keeps trying until succeeded, returns the number of attempts it took;
+    // every attempt has its own seed derived from the quest id,
+    // so that any attempt can be reproduced independently
+    static int generate(QuestId questId, e::Graph &outEGraph, Vector<Level> &outLevels,
+        GenerationStats *outStats = nullptr, PropertyStats *propertyStats = nullptr)
     {
-        // all expressions we've collected:
-        HashMap<ClassId, Vector<Hint::Ptr>> allExpressions;
+        for (int attempt = 0;; ++attempt)
+        {
+            outEGraph = {};
+            outLevels = {};
+
+            QuestGenerator generator(outEGraph, Random::mixSeed(questId, attempt));
+            generator.setPropertyStats(propertyStats);
+            const auto succeeded = generator.tryGenerate(outLevels);
+
+            if (outStats != nullptr)
+            {
+                generator.collectStats(*outStats);
+            }
+
+            if (propertyStats != nullptr)
+            {
+                propertyStats->add(generator.getPropertyIndices(), generator.getFailureReason());
+            }
+
+            if (succeeded)
+            {
+                return attempt + 1;
+            }
+        }
+    }
+
+#if !WEB_CLIENT
+
+    // same as above, but runs several attempts at once, so that the latency
+    // doesn't add up when attempts fail late; the result is the same as
+    // with sequential attempts, because the successful attempt with the lowest
+    // number wins: attempts after it are cancelled, attempts before it are
+    // allowed to finish, since one of them may still succeed
+    static int generate(QuestId questId, int numThreads, e::Graph &outEGraph, Vector<Level> &outLevels,
+        GenerationStats *outStats = nullptr, PropertyStats *propertyStats = nullptr)
+    {
+        if (numThreads <= 1)
+        {
+            return QuestGenerator::generate(questId, outEGraph, outLevels, outStats, propertyStats);
+        }
+
+        std::atomic<int> nextAttempt {0};
+        std::atomic<int> bestAttempt {INT_MAX};
+        std::mutex resultMutex;
+
+        // only when all attempts are done it's known which successful one has won,
+        // so the stats are collected at the end, in the order of attempts
+        SortedMap<int, std::pair<GenerationStats, FailureReason>> attemptStats;
+
+        const auto runAttempts = [&]()
+        {
+            while (true)
+            {
+                const auto attempt = nextAttempt.fetch_add(1);
+                if (attempt > bestAttempt.load())
+                {
+                    return;
+                }
+
+                e::Graph eGraph;
+                Vector<Level> levels;
+
+                QuestGenerator generator(eGraph, Random::mixSeed(questId, attempt),
+                    [&bestAttempt, attempt]() { return bestAttempt.load() < attempt; });
+
+                generator.setPropertyStats(propertyStats);
+                const auto succeeded = generator.tryGenerate(levels);
+
+                if (propertyStats != nullptr)
+                {
+                    propertyStats->add(generator.getPropertyIndices(), generator.getFailureReason());
+                }
+
+                std::lock_guard<std::mutex> lock(resultMutex);
+
+                if (succeeded && attempt < bestAttempt.load())
+                {
+                    bestAttempt = attempt;
+                    outEGraph = move(eGraph);
+                    outLevels = move(levels);
+                }
+
+                if (outStats != nullptr)
+                {
+                    attemptStats[attempt] = {generator.getStats(), generator.getFailureReason()};
+                }
+            }
+        };
+
+        Vector<std::thread> workers;
+        for (int i = 0; i < numThreads; ++i)
+        {
+            workers.emplace_back(runAttempts);
+        }
+
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+
+        if (outStats != nullptr)
+        {
+            for (const auto &it : attemptStats)
+            {
+                // the later successful attempts have lost to the winning one,
+                // and the rewrite passes should be the ones of the winner
+                const auto isSuperseded = it.second.second == FailureReason::None && it.first != bestAttempt.load();
+                QuestGenerator::collectStats(*outStats, it.second.first,
+                    isSuperseded ? FailureReason::Superseded : it.second.second);
+            }
+        }
+
+        return bestAttempt.load() + 1;
+    }
+
+#endif
+
+    // if set, each level's property is picked by how well it has worked before
+    // (only if the stats are adaptive, otherwise uniformly, as without them)
+    void setPropertyStats(PropertyStats *stats)
+    {
+        this->propertyStats = stats;
+    }
 
+    // makes the attempt use the given properties, one per level, as indices
+    // in AlienAlgebra::allProperties, for the tools that check specific combinations
+    // (see PropertyCompatibility)
+    void forceProperties(const Vector<int> &propertyIndices)
+    {
+        assert(propertyIndices.size() == QuestGenerator::numLevels);
+        this->forcedPropertyIndices = propertyIndices;
+    }
+
+    // why the last attempt has failed, if it has
+    FailureReason getFailureReason() const noexcept
+    {
+        return this->failureReason;
+    }
+
+    // the properties picked for each level, as indices in AlienAlgebra::allProperties
+    const Vector<int> &getPropertyIndices() const noexcept
+    {
+        return this->propertyIndices;
+    }
+
+    // an attempt is made of three steps, which are public
+    // so that they can be measured separately (see GameBench)
+    bool tryGenerate(Vector<Level> &outLevels)
+    {
         // each level will contain a number of expressions to work with:
         Vector<HashSet<ClassId>> questClasses;
 
-        if (!this->buildEGraph(allExpressions, questClasses))
         {
-            //assert(false);
+            GenerationStats::Timer timer(this->stats.buildEGraphSeconds);
+            if (!this->buildEGraph(questClasses))
+            {
+                //assert(false);
+                return false;
+            }
+        }
+
+        if (this->isCancelled && this->isCancelled())
+        {
+            this->failureReason = FailureReason::Cancelled;
             return false;
         }
 
+        // all expressions we've collected:
+        SortedMap<ClassId, Vector<Hint::Ptr>> allExpressions;
+        {
+            GenerationStats::Timer timer(this->stats.extractHintsSeconds);
+            allExpressions = this->extractHints();
+        }
+
+        GenerationStats::Timer timer(this->stats.buildLevelsSeconds);
+        return this->buildLevels(allExpressions, questClasses, outLevels);
+    }
+
+    // the stats of this attempt only
+    const GenerationStats &getStats() const noexcept
+    {
+        return this->stats;
+    }
+
+    // adds this attempt to the stats, as a failed one if it has a failure reason
+    void collectStats(GenerationStats &outStats) const
+    {
+        QuestGenerator::collectStats(outStats, this->stats, this->failureReason);
+    }
+
+    static void collectStats(GenerationStats &outStats,
+        const GenerationStats &attemptStats, FailureReason failureReason)
+    {
+        const auto succeeded = failureReason == FailureReason::None;
+        outStats.add(attemptStats);
+        outStats.numAttempts++;
+        outStats.numFailedAttempts += int(!succeeded);
+        if (!succeeded)
+        {
+            outStats.numFailuresByReason[int(failureReason)]++;
+        }
+        else
+        {
+            outStats.initialGraphSize = attemptStats.initialGraphSize;
+            outStats.rewritePasses = attemptStats.rewritePasses;
+            outStats.propertyIndices = attemptStats.propertyIndices;
+        }
+    }
+
+    // picks the question, the hint and the suggestions for each level
+    // out of the extracted expressions, ranking them by a bunch of heuristics
+    bool buildLevels(const SortedMap<ClassId, Vector<Hint::Ptr>> &allExpressions,
+        const Vector<HashSet<ClassId>> &questClasses, Vector<Level> &outLevels)
+    {
         // keep track of which operations were shown, so we don't introduce
         // unknown operations at each new level:
-        HashSet<String> shownOperations;
+        SymbolSet shownOperations;
+
+        // for the containers only needed while picking, unlike the hints, see Arena.h
+        Arena scratch;
 
         for (int levelNumber = 0; levelNumber < QuestGenerator::numLevels; ++levelNumber)
         {
+            if (this->isCancelled && this->isCancelled())
+            {
+                this->failureReason = FailureReason::Cancelled;
+                return false;
+            }
+
             Level level;
 
             {
@@ -91,6 +334,7 @@ struct QuestGenerator final
             if (level.allUsedExpressions.empty())
             {
                 //assert(false);
+                this->failureReason = FailureReason::NoExpressions;
                 return false;
             }
 
@@ -125,28 +369,24 @@ struct QuestGenerator final
 
             // pick the question:
             {
-                std::sort(expressionsForQuestion.begin(), expressionsForQuestion.end(),
-                    [&](const Hint::Ptr &a, const Hint::Ptr &b)
+                const auto questionCandidates = QuestGenerator::selectBest(expressionsForQuestion, 1,
+                    [&](const Hint::Ptr &hint)
                     {
-                        const auto getScore = [&](const Hint::Ptr &hint)
-                        {
-                            int score = 0;
-                            // must have at least one op which wasn't shown yet:
-                            score -= int(hint->getNumNewOperations(shownOperations) != 1) * 100;
-                            score += int(hint->usedLeafIds.size()) * 10;
-                            score += hint->astDepth;
-                            return score;
-                        };
-
-                        return getScore(a) > getScore(b);
+                        int score = 0;
+                        // must have at least one op which wasn't shown yet:
+                        score -= int(hint->getNumNewOperations(shownOperations) != 1) * 100;
+                        score += int(hint->usedLeafIds.size()) * 10;
+                        score += hint->astDepth;
+                        return score;
                     });
 
-                level.question = expressionsForQuestion.front();
+                level.question = questionCandidates.front();
 
                 if (level.question->getNumNewOperations(shownOperations) != 1)
                 {
                     // we need a question with exactly 1 unknown operation
                     //assert(false);
+                    this->failureReason = FailureReason::NoQuestion;
                     return false;
                 }
 
@@ -155,105 +395,103 @@ struct QuestGenerator final
                 level.operation = newOperations.front();
                 shownOperations.insert(level.operation);
 
+                ArenaHashSet<uint64_t> answerHashes(&scratch);
+                ArenaHashSet<uint64_t> wrongAnswerHashes(&scratch);
                 for (const auto &hint : expressionsForQuestion)
                 {
                     if (hint != level.question &&
                         hint->getNumNewOperations(shownOperations) == 0)
                     {
-                        level.answers.insert(hint->formatted);
+                        if (answerHashes.insert(hint->hash).second)
+                        {
+                            level.answers.push_back(hint);
+                        }
 
-                        append(level.allTermSymbolsInAnswers, hint->usedTermSymbols);
-                        append(level.allOperationSymbolsInAnswers, hint->usedOperationSymbols);
+                        level.allTermSymbolsInAnswers |= hint->usedTermSymbols;
+                        level.allOperationSymbolsInAnswers |= hint->usedOperationSymbols;
 
-                        Hint wrongAnswer(*hint);
-                        wrongAnswer.replaceRandomNode(this->random,
-                            this->random.pickOne(level.allTermSymbolsInAnswers));
+                        auto wrongAnswer = Hint::make(this->arena, *hint);
+                        wrongAnswer->replaceRandomNode(this->random,
+                            this->random.pickOne(level.allTermSymbolsInAnswers.toVector()));
 
-                        wrongAnswer.collectInfo();
-                        level.wrongAnswers.insert(wrongAnswer.formatted);
+                        wrongAnswer->collectInfo();
+                        if (wrongAnswerHashes.insert(wrongAnswer->hash).second)
+                        {
+                            level.wrongAnswers.push_back(wrongAnswer);
+                        }
                     }
                 }
 
                 if (level.answers.empty())
                 {
                     //assert(false);
+                    this->failureReason = FailureReason::NoAnswers;
                     return false;
                 }
             }
 
             // pick the left-hand and right-hand sides for the hint:
-            auto rankedHintsForLeftHandSide = level.allUsedExpressions;
-            std::sort(rankedHintsForLeftHandSide.begin(), rankedHintsForLeftHandSide.end(),
-                [&](const Hint::Ptr &a, const Hint::Ptr &b)
+            const auto rankedHintsForLeftHandSide = QuestGenerator::selectBest(level.allUsedExpressions, 1,
+                [&](const Hint::Ptr &hint)
                 {
-                    const auto getScore = [&](const Hint::Ptr &hint)
-                    {
-                        int score = 0;
-
-                        // penalty for all hints from question's class
-                        // (but sometimes it's all we got)
-                        score -= int(level.question == hint) * 10000;
-                        score -= int(level.question->rootId == hint->rootId) * 1000;
+                    int score = 0;
 
-                        // should not show hints with operations "unknown" to user
-                        score -= hint->getNumNewOperations(shownOperations) * 100;
+                    // penalty for all hints from question's class
+                    // (but sometimes it's all we got)
+                    score -= int(level.question == hint) * 10000;
+                    score -= int(level.question->rootId == hint->rootId) * 1000;
 
-                        score -= int(hint->astDepth == level.question->astDepth) * 20;
-                        score += hint->astDepth * 10;
+                    // should not show hints with operations "unknown" to user
+                    score -= hint->getNumNewOperations(shownOperations) * 100;
 
-                        score += int(hint->usedOperationSymbols.size()) * 10;
+                    score -= int(hint->astDepth == level.question->astDepth) * 20;
+                    score += hint->astDepth * 10;
 
-                        score += int(contains(hint->usedOperationSymbols, level.operation));
+                    score += int(hint->usedOperationSymbols.size()) * 10;
 
-                        return score;
-                    };
+                    score += int(hint->usedOperationSymbols.contains(level.operation));
 
-                    return getScore(a) > getScore(b);
+                    return score;
                 });
 
             level.hintLeftHand = rankedHintsForLeftHandSide.front();
 
-            auto rankedHintsForRightHandSide = level.allUsedExpressions;
-            std::sort(rankedHintsForRightHandSide.begin(), rankedHintsForRightHandSide.end(),
-                [&](const Hint::Ptr &a, const Hint::Ptr &b)
+            const auto rankedHintsForRightHandSide = QuestGenerator::selectBest(level.allUsedExpressions, 1,
+                [&](const Hint::Ptr &hint)
                 {
-                    const auto getScore = [&](const Hint::Ptr &hint)
-                    {
-                        int score = 0;
-
-                        score -= int(level.question == hint || level.hintLeftHand == hint) * 10000;
-                        score -= int(level.question->rootId == hint->rootId) * 1000;
+                    int score = 0;
 
-                        score -= hint->getNumNewOperations(shownOperations) * 100;
+                    score -= int(level.question == hint || level.hintLeftHand == hint) * 10000;
+                    score -= int(level.question->rootId == hint->rootId) * 1000;
 
-                        score -= int(hint->astDepth == level.question->astDepth) * 20;
-                        //score += hint->astDepth * 10;
+                    score -= hint->getNumNewOperations(shownOperations) * 100;
 
-                        score += int(hint->usedOperationSymbols.size()) * 10;
+                    score -= int(hint->astDepth == level.question->astDepth) * 20;
+                    //score += hint->astDepth * 10;
 
-                        score += int(contains(hint->usedOperationSymbols, level.operation));
+                    score += int(hint->usedOperationSymbols.size()) * 10;
 
-                        if (hint->astDepth > 1 && level.hintLeftHand->astDepth > 1 &&
-                            (hint->rootNode.children.front().name == level.hintLeftHand->rootNode.children.front().name ||
-                                hint->rootNode.children.back().name == level.hintLeftHand->rootNode.children.back().name))
-                        {
-                            score -= 10;
-                        }
+                    score += int(hint->usedOperationSymbols.contains(level.operation));
 
-                        score -= int(hint->usedTermSymbols == level.hintLeftHand->usedTermSymbols);
-                        score -= int(hint->astDepth == level.hintLeftHand->astDepth);
+                    if (hint->astDepth > 1 && level.hintLeftHand->astDepth > 1 &&
+                        (hint->rootNode.children.front().symbol == level.hintLeftHand->rootNode.children.front().symbol ||
+                            hint->rootNode.children.back().symbol == level.hintLeftHand->rootNode.children.back().symbol))
+                    {
+                        score -= 10;
+                    }
 
-                        return score;
-                    };
+                    score -= int(hint->usedTermSymbols == level.hintLeftHand->usedTermSymbols);
+                    score -= int(hint->astDepth == level.hintLeftHand->astDepth);
 
-                    return getScore(a) > getScore(b);
+                    return score;
                 });
 
             level.hintRightHand = rankedHintsForRightHandSide.front();
 
-            if (!contains(level.hintLeftHand->usedOperationSymbols, level.operation) &&
-                !contains(level.hintRightHand->usedOperationSymbols, level.operation))
+            if (!level.hintLeftHand->usedOperationSymbols.contains(level.operation) &&
+                !level.hintRightHand->usedOperationSymbols.contains(level.operation))
             {
+                this->failureReason = FailureReason::NoHintWithOperation;
                 return false;
             }
 
@@ -264,25 +502,30 @@ struct QuestGenerator final
 
             // pick the suggestions:
             {
-                std::sort(expressionsForSuggestions.begin(), expressionsForSuggestions.end(),
-                    [&](const Hint::Ptr &a, const Hint::Ptr &b)
+                const auto bestExpressionsForSuggestions = QuestGenerator::selectBest(expressionsForSuggestions, 3,
+                    [&](const Hint::Ptr &hint)
                     {
-                        const auto getScore = [&](const Hint::Ptr &hint)
-                        {
-                            int score = 0;
-                            score -= (hint->formatted == level.hintLeftHand->formatted ||
-                                hint->formatted == level.hintRightHand->formatted) * 10;
-                            // prioritize "similar look" (having as much of the same symbols as in the answers)
-                            score -= hint->getNumNewTerms(level.allTermSymbolsInAnswers);
-                            return score;
-                        };
-
-                        return getScore(a) > getScore(b);
+                        int score = 0;
+                        score -= (hint->hash == level.hintLeftHand->hash ||
+                            hint->hash == level.hintRightHand->hash) * 10;
+                        // prioritize "similar look" (having as much of the same symbols as in the answers)
+                        score -= hint->getNumNewTerms(level.allTermSymbolsInAnswers);
+                        return score;
                     });
 
-                HashSet<String> uniqueSuggestions;
+                // only the hints that are actually suggested get formatted
+                HashSet<uint64_t> suggestionHashes;
+                const auto addSuggestion = [&](const Hint::Ptr &hint)
                 {
-                    HashSet<String> usedAnswers;
+                    if (suggestionHashes.insert(hint->hash).second)
+                    {
+                        level.suggestions.push_back(hint->getFormatted());
+                    }
+                };
+
+                {
+                    UniquePicker<Hint::Ptr> answers(level.answers);
+                    UniquePicker<Hint::Ptr> wrongAnswers(level.wrongAnswers);
 
                     // level 0 is introductory,
                     // level 1 should have more valid answers in suggestions (bait)
@@ -291,23 +534,20 @@ struct QuestGenerator final
                     for (int i = 0; i < std::min(3 + int(levelNumber == 1) - int(isLastLevel),
                         int(level.answers.size())); ++i)
                     {
-                        uniqueSuggestions.insert(this->random.pickOneUnique(level.answers, usedAnswers));
+                        addSuggestion(answers.pick(this->random));
                     }
 
                     for (int i = 0; i < std::min(3 + int(isLastLevel), int(level.wrongAnswers.size())); ++i)
                     {
-                        uniqueSuggestions.insert(this->random.pickOneUnique(level.wrongAnswers, usedAnswers));
+                        addSuggestion(wrongAnswers.pick(this->random));
                     }
                 }
 
-                for (int i = 0; i < std::min(3, int(expressionsForSuggestions.size())); ++i)
+                for (const auto &hint : bestExpressionsForSuggestions)
                 {
-                    uniqueSuggestions.insert(expressionsForSuggestions[i]->formatted);
+                    addSuggestion(hint);
                 }
 
-                level.suggestions.insert(level.suggestions.end(),
-                    uniqueSuggestions.begin(), uniqueSuggestions.end());
-
                 this->random.shuffle(level.suggestions);
             }
 
@@ -320,8 +560,8 @@ struct QuestGenerator final
 
             for (const auto &hint : level.allUsedExpressions)
             {
-                append(level.allKnownTerms, hint->usedTermSymbols);
-                append(level.allKnownOperations, hint->usedOperationSymbols);
+                level.allKnownTerms |= hint->usedTermSymbols;
+                level.allKnownOperations |= hint->usedOperationSymbols;
             }
 
             outLevels.push_back(move(level));
@@ -330,33 +570,65 @@ struct QuestGenerator final
         return true;
     }
 
-    bool buildEGraph(HashMap<ClassId, Vector<Hint::Ptr>> &outHints, Vector<HashSet<ClassId>> &outQuestClasses)
+    // adds the expressions for all levels and saturates the graph with their rules
+    bool buildEGraph(Vector<HashSet<ClassId>> &outQuestClasses)
     {
         HashSet<OperationProperty> usedProperties;
         Vector<OperationProperty> propertiesByLevel;
 
-        for (int levelNumber = 0; levelNumber < numLevels; ++levelNumber)
+        for (int levelNumber = 0; levelNumber < numLevels && this->forcedPropertyIndices.empty(); ++levelNumber)
         {
-            HashSet<OperationProperty> availableForThisLevel;
+            Vector<OperationProperty> availableForThisLevel;
             for (const auto &property : AlienAlgebra::allProperties)
             {
                 if (contains(property.levels, levelNumber))
                 {
-                    availableForThisLevel.insert(property);
+                    availableForThisLevel.push_back(property);
                 }
             }
 
-            propertiesByLevel.push_back(this->random.pickOneUnique(availableForThisLevel, usedProperties));
+            const auto property = (this->propertyStats != nullptr && this->propertyStats->isAdaptive) ?
+                this->pickWeightedProperty(levelNumber, availableForThisLevel, usedProperties) :
+                this->random.pickOneUnique(availableForThisLevel, usedProperties);
+
+            propertiesByLevel.push_back(property);
+            this->propertyIndices.push_back(QuestGenerator::getPropertyIndex(property));
+        }
+
+        if (!this->forcedPropertyIndices.empty())
+        {
+            this->propertyIndices = this->forcedPropertyIndices;
+            for (const auto propertyIndex : this->propertyIndices)
+            {
+                propertiesByLevel.push_back(AlienAlgebra::allProperties[propertyIndex]);
+            }
         }
 
+        this->stats.propertyIndices = this->propertyIndices;
+
         Vector<RewriteRule> allRewriteRules;
 
-        HashSet<Symbol> usedTerms;
+        const auto &alphabet = Alphabet::getInterner();
+
+        UniquePicker<SymbolId> terms(alphabet.getTermIds());
         HashSet<int> usedOperationGroups;
 
-        HashSet<ClassId> recycledTermIds;
-        HashSet<ClassId> recycledTermIdsForNextStep;
-        HashSet<ClassId> usedRecycledTermIds;
+        // the terms to reuse are picked in the order they were added,
+        // so that the same seed gives the same graph on any platform
+        UniquePicker<ClassId> recycledTermIds;
+        HashSet<ClassId> allRecycledTermIds;
+        Vector<ClassId> recycledTermIdsForNextStep;
+
+        const auto recycleTermIds = [&](const Vector<ClassId> &termIds)
+        {
+            for (const auto termId : termIds)
+            {
+                if (allRecycledTermIds.insert(termId).second)
+                {
+                    recycledTermIds.add(termId);
+                }
+            }
+        };
 
         Vector<HashSet<ClassId>> questsLeafIds;
 
@@ -395,13 +667,13 @@ struct QuestGenerator final
 
         for (const auto &operationProperty : propertiesByLevel)
         {
-            const auto operationSymbol = this->random.pickOne(
-                this->random.pickOneUnique(this->allOperations, usedOperationGroups));
+            const auto &operationSymbol = alphabet.getSymbol(this->random.pickOne(
+                this->random.pickOneUnique(alphabet.getOperationGroupIds(), usedOperationGroups)));
 
             const auto makeRandomTerm = [&]()
             {
-                const auto termSymbol = this->random.pickOneUnique(this->allTerms, usedTerms);
-                const auto termId = this->eGraph.addTerm(termSymbol);
+                const auto termSymbol = terms.pick(this->random);
+                const auto termId = this->eGraph.addTerm(alphabet.getSymbol(termSymbol));
                 return termId;
             };
 
@@ -412,7 +684,7 @@ struct QuestGenerator final
                     return makeRandomTerm();
                 }
 
-                return this->random.pickOneUnique(recycledTermIds, usedRecycledTermIds);
+                return recycledTermIds.pick(this->random);
             };
 
             const auto makeRandomTermOrReuseD2 = [&]()
@@ -422,7 +694,7 @@ struct QuestGenerator final
                     return makeRandomTerm();
                 }
 
-                return this->random.pickOneUnique(recycledTermIds, usedRecycledTermIds);
+                return recycledTermIds.pick(this->random);
             };
 
 
@@ -436,7 +708,8 @@ struct QuestGenerator final
             // with different symbols (it also makes hints more predictable)
             ClassId termL1, termR1, termL2, termR2, termL3, termR3, termL4, termR4;
 
-            const auto levelRewriteRule = Parser::makeRewriteRule(operationProperty.rewriteTemplate, operationSymbol);
+            const auto levelRewriteRule = Parser::replaceOperationSymbol(
+                QuestGenerator::getRuleTemplate(operationProperty), operationSymbol);
 
             switch (getLeftHandSideShapeType(levelRewriteRule))
             {
@@ -485,8 +758,8 @@ struct QuestGenerator final
             const auto operationId3 = this->eGraph.addOperation(operationSymbol, {termL3, termR3});
             const auto operationId4 = this->eGraph.addOperation(operationSymbol, {termL4, termR4});
 
-            recycledTermIds.insert({operationId3, termL3, operationId4});
-            recycledTermIds.insert(recycledTermIdsForNextStep.begin(), recycledTermIdsForNextStep.end());
+            recycleTermIds({operationId3, termL3, operationId4});
+            recycleTermIds(recycledTermIdsForNextStep);
             recycledTermIdsForNextStep = {operationId1, termL4, operationId2};
 
             questsLeafIds.push_back({operationId1, operationId2});
@@ -494,20 +767,11 @@ struct QuestGenerator final
             allRewriteRules.push_back(levelRewriteRule);
         }
 
-        {
-            for (int i = 0; i < 32; ++i)
-            {
-                for (const auto &rule : allRewriteRules)
-                {
-                    this->eGraph.rewrite(rule);
+        this->stats.initialGraphSize = {int(this->eGraph.classes.size()), int(this->eGraph.termsLookup.size())};
 
-                    if (this->eGraph.classes.size() > (usedTerms.size() + usedOperationGroups.size()) * 5)
-                    {
-                        //assert(false); // something has gone terribly wrong
-                        return false;
-                    }
-                }
-            }
+        if (!this->saturate(allRewriteRules, (terms.getNumPicked() + usedOperationGroups.size()) * 5))
+        {
+            return false;
         }
 
         outQuestClasses.clear();
@@ -521,71 +785,257 @@ struct QuestGenerator final
             outQuestClasses.push_back(move(rootClasses));
         }
 
+        return true;
+    }
+
+    // applies the rules to the e-graph until nothing changes, or until it has more
+    // than the given number of classes, which means the rules don't play well together;
+    // public for the tools which check the properties (see PropertyCompatibility)
+    bool saturate(const Vector<RewriteRule> &rules, size_t maxNumClasses)
+    {
+        // saturate until a fixpoint: a rewrite that has changed nothing
+        // doesn't need to be applied again until the graph changes where it could match;
+        // so the rules form a worklist, and a pass that finds it empty is the last one;
+        // a rule can only find new matches in the classes that have changed,
+        // and only if they have nodes with the operations of its left hand
+        Vector<HashSet<Symbol>> ruleOperations(rules.size());
+        for (int ruleIndex = 0; ruleIndex < rules.size(); ++ruleIndex)
         {
-            HintsExtractor hintsExtractor(this->eGraph);
-            outHints = hintsExtractor.extract();
+            QuestGenerator::collectOperations(rules[ruleIndex].leftHand, ruleOperations[ruleIndex]);
+        }
+
+        Vector<bool> dirtyRules(rules.size(), true);
+
+        auto classFingerprints = this->getClassFingerprints();
+
+        for (int i = 0; i < QuestGenerator::maxRewritePasses; ++i)
+        {
+            if (this->isCancelled && this->isCancelled())
+            {
+                this->failureReason = FailureReason::Cancelled;
+                return false;
+            }
+
+            if (std::none_of(dirtyRules.begin(), dirtyRules.end(), [](bool isDirty) { return isDirty; }))
+            {
+                break;
+            }
+
+            for (int ruleIndex = 0; ruleIndex < rules.size(); ++ruleIndex)
+            {
+                if (!dirtyRules[ruleIndex])
+                {
+                    continue;
+                }
+
+                this->eGraph.rewrite(rules[ruleIndex]);
+
+                if (this->eGraph.classes.size() > maxNumClasses)
+                {
+                    //assert(false); // something has gone terribly wrong
+                    this->failureReason = FailureReason::GraphExplosion;
+                    this->stats.addRewritePass(int(this->eGraph.classes.size()), int(this->eGraph.termsLookup.size()));
+                    return false;
+                }
+
+                // the fingerprints after this rewrite are the ones before the next one
+                auto newClassFingerprints = this->getClassFingerprints();
+
+                HashSet<Symbol> changedSymbols;
+                for (const auto &it : newClassFingerprints)
+                {
+                    const auto found = classFingerprints.find(it.first);
+                    if (found == classFingerprints.end() || found->second != it.second)
+                    {
+                        for (const auto &term : this->eGraph.classes.at(it.first)->terms)
+                        {
+                            changedSymbols.insert(term->name);
+                        }
+                    }
+                }
+
+                classFingerprints = move(newClassFingerprints);
+
+                // including the rule itself, which may have more to do on the nodes it has just added
+                dirtyRules[ruleIndex] = false;
+                for (int otherIndex = 0; otherIndex < rules.size() && !changedSymbols.empty(); ++otherIndex)
+                {
+                    for (const auto &operation : ruleOperations[otherIndex])
+                    {
+                        if (contains(changedSymbols, operation))
+                        {
+                            dirtyRules[otherIndex] = true;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            this->stats.addRewritePass(int(this->eGraph.classes.size()), int(this->eGraph.termsLookup.size()));
         }
 
         return true;
     }
 
-private:
+    SortedMap<ClassId, Vector<Hint::Ptr>> extractHints()
+    {
+        HintsExtractor hintsExtractor(this->eGraph, this->random.nextSeed());
+        hintsExtractor.setArena(this->arena);
+        auto result = hintsExtractor.extract();
 
-#if WEB_CLIENT
-
-    const HashSet<Symbol> allTerms = {
-        "a", "d", "e", "f", "n", "o", "q", "s", "u", "v", "w", "x", "y", "z",
-        "0", "1", "3", "4", "5", "7", "9"
-    };
-
-    const Vector<HashSet<Symbol>> allOperations = {
-        {"\xe2\x87\x8c", "\xe2\xa5\xa2", "\xe2\xa5\xa4"}, // ⇌ ⥢ ⥤
-        {"\xe2\xa5\x83", "\xe2\xa5\x84"}, // ⥃ ⥄
-        {"\xe2\xa4\x9d", "\xe2\xa4\x9e", "\xe2\x87\x9c", "\xe2\x87\x9d"}, // ⤝ ⤞ ⇜ ⇝
-        {"\xe2\x86\xab", "\xe2\x86\xac", "\xe2\x86\x9c", "\xe2\x86\x9d"}, // ↫ ↬ ↜ ↝
-        {"\xe2\xac\xb8", "\xe2\xa4\x91"}, // ⬸ ⤑
-        {"\xe2\xa4\x99", "\xe2\xa4\x9a", "\xe2\xa4\x9c"}, // ⤙ ⤚ ⤜
-        {"\xe2\xa5\x8a", "\xe2\xa5\x90", "\xe2\x86\xbd", "\xe2\x87\x80"}, // ⥊ ⥐ ↽ ⇀
-        {"\xe2\xa4\xbe", "\xe2\xa4\xbf", "\xe2\xa4\xb8", "\xe2\xa4\xb9", "\xe2\xa4\xbb"}, // ⤾ ⤿ ⤸ ⤹ ⤻
-        {"\xe2\x88\xb4", "\xe2\x88\xb5"}, // ∴ ∵
-        {"\xe2\xa0\x94", "\xe2\xa0\xa2"}, // ⠔ ⠢
-        {"\xe2\x88\xba", "\xe2\x88\xbb"}, // ∺ ∻
-        //{"\xe2\xac\xb7", "\xe2\xa4\x90"}, // ⬷ ⤐
-        {"\xe2\x89\x80"}, // ≀
-        //{"\xe2\xa5\x88"}, // ⥈
-        //{"\xe2\x9e\xbb"} // ➻
-    };
-
-#else
-
-    const HashSet<Symbol> allTerms = {
-        "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m",
-        "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z"
-    };
-
-    const Vector<HashSet<Symbol>> allOperations = {
-        {"~~", "~"},
-        {"-<", ">-"},
-        {"|-", "-|"},
-        {"~>", "<~", "<~>"},
-        {"-/", "/-"},
-        {":>", "|>", "/>"},
-        {"#", "@"},
-        {"$", "&"},
-        {"?", "!"},
-        {"==<", ">=="},
-        {">>-", "-<<"},
-        {"::"},
-        {"."}
-    };
+        this->stats.numCandidateExpressions += hintsExtractor.getNumCandidateExpressions();
+        this->stats.numEnumeratedExpressions += hintsExtractor.getNumEnumeratedExpressions();
+        for (const auto &it : result)
+        {
+            this->stats.numHints += it.second.size();
+        }
 
-#endif
+        return result;
+    }
 
 private:
 
-    static constexpr auto numLevels = 4;
+    // the sizes of the graph are not enough to tell if a class has changed, since
+    // a rewrite can add a node, merge classes and dedupe a node in one go,
+    // so it's the fingerprint of all its nodes, each with its class and its children's classes,
+    // summed up so that the order of the hash maps doesn't matter
+    HashMap<ClassId, uint64_t> getClassFingerprints() const
+    {
+        HashMap<ClassId, uint64_t> result;
+        result.reserve(this->eGraph.classes.size());
+        for (const auto &it : this->eGraph.classes)
+        {
+            const auto classHash = Hashing::combine(Hashing::initialValue, uint64_t(it.first));
+            uint64_t fingerprint = 0;
+            for (const auto &term : it.second->terms)
+            {
+                auto termHash = Hashing::combine(classHash, term->name);
+                for (const auto childId : term->childrenIds)
+                {
+                    termHash = Hashing::combine(termHash, uint64_t(this->eGraph.find(childId)));
+                }
+
+                fingerprint += Random::mixSeed(termHash, 0);
+            }
+
+            result[it.first] = fingerprint;
+        }
+
+        return result;
+    }
+
+    static void collectOperations(const e::Pattern &pattern, HashSet<Symbol> &outOperations)
+    {
+        if (pattern.term == nullptr)
+        {
+            return; // a variable matches any class
+        }
+
+        outOperations.insert(pattern.term->name);
+        for (const auto &argument : pattern.term->arguments)
+        {
+            QuestGenerator::collectOperations(argument, outOperations);
+        }
+    }
+
+    // scores each hint exactly once and returns the k best ones, best first,
+    // without sorting the rest; ties go to the hint that comes first,
+    // so that the result doesn't depend on the sorting algorithm
+    template <typename F>
+    static Vector<Hint::Ptr> selectBest(const Vector<Hint::Ptr> &hints, int k, F &&getScore)
+    {
+        Vector<std::pair<int, int>> scores; // score and index
+        scores.reserve(hints.size());
+        for (int i = 0; i < hints.size(); ++i)
+        {
+            scores.emplace_back(getScore(hints[i]), i);
+        }
+
+        const auto numSelected = std::min(k, int(scores.size()));
+        std::partial_sort(scores.begin(), scores.begin() + numSelected, scores.end(),
+            [](const std::pair<int, int> &a, const std::pair<int, int> &b)
+            {
+                return a.first > b.first || (a.first == b.first && a.second < b.second);
+            });
+
+        Vector<Hint::Ptr> result;
+        result.reserve(numSelected);
+        for (int i = 0; i < numSelected; ++i)
+        {
+            result.push_back(hints[scores[i].second]);
+        }
+
+        return result;
+    }
+
+    // same as Random::pickOneUnique, but the chances are proportional to the success rates
+    OperationProperty pickWeightedProperty(int levelNumber,
+        const Vector<OperationProperty> &available, HashSet<OperationProperty> &used)
+    {
+        Vector<OperationProperty> candidates;
+        Vector<int> candidateIndices;
+        for (const auto &property : available)
+        {
+            if (!contains(used, property))
+            {
+                candidates.push_back(property);
+                candidateIndices.push_back(QuestGenerator::getPropertyIndex(property));
+            }
+        }
+
+        if (candidates.empty())
+        {
+            return this->random.pickOneUnique(available, used);
+        }
+
+        const auto weights = this->propertyStats->getWeights(levelNumber, candidateIndices);
+        const auto &result = candidates[this->random.pickWeightedIndex(weights)];
+        used.insert(result);
+        return result;
+    }
+
+    static int getPropertyIndex(const OperationProperty &property)
+    {
+        const auto &all = AlienAlgebra::allProperties;
+        const auto found = std::find(all.begin(), all.end(), property);
+        assert(found != all.end());
+        return int(found - all.begin());
+    }
+
+    // the property templates never change, so they are parsed only once,
+    // on the first use, into rules with placeholder operation symbols
+    static const RewriteRule &getRuleTemplate(const OperationProperty &property)
+    {
+        static const auto ruleTemplates = []()
+        {
+            HashMap<String, RewriteRule> result;
+            for (const auto &property : AlienAlgebra::allProperties)
+            {
+                result[property.rewriteTemplate] = Parser::makeRewriteRule(property.rewriteTemplate, {});
+            }
+            return result;
+        }();
+
+        return ruleTemplates.at(property.rewriteTemplate);
+    }
+
+    // the first block of the arena, the next ones grow from it
+    static constexpr size_t arenaBlockSize = 64 * 1024;
 
     e::Graph &eGraph;
 
-    Random &random;
+    Random random;
+
+    CancellationCheck isCancelled;
+
+    // the hints of this attempt, see Arena.h; the hints keep it alive,
+    // so it's gone as soon as the attempt's levels are
+    std::shared_ptr<Arena> arena;
+
+    GenerationStats stats;
+
+    PropertyStats *propertyStats = nullptr;
+    Vector<int> propertyIndices;
+    Vector<int> forcedPropertyIndices;
+    FailureReason failureReason = FailureReason::None;
 };
@@ -0,0 +1,453 @@
+#pragma once
+
+#include "Common.h"
+#include "Quest.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define QUEST_POOL_MMAP 1
+#endif
+
+// A binary file of pre-generated quests, written offline by the batch
+// generator and memory-mapped at startup, so that starting a game is
+// just decoding one record instead of building and saturating an e-graph.
+//
+// All numbers are little-endian, strings are u32 length + bytes:
+//   header:  "AAQP", u32 version, u32 numQuests, u64 offset of the offsets table
+//   quest:   u64 id, u32 numLevels, levels..., u32 numClasses, classes...,
+//            u32 numHashedNames, (str name, str hashedName)... (sorted)
+//   level:   str hint, str question, u32 questionClass, u64 questionHash,
+//            u32 numSuggestions, (str suggestion, u64 hash)...,
+//            u32 numValidAnswers, u64 hash... (sorted)
+//   class:   u32 numNodes, nodes...
+//   node:    str name, u32 numChildren, u32 childClass...
+//   offsets: u64 offset of each quest, written at the end,
+//            so that quests can be streamed into the file as they come
+
+namespace QuestPoolFormat
+{
+    static constexpr char magic[4] = {'A', 'A', 'Q', 'P'};
+    static constexpr uint32_t version = 3;
+    static constexpr size_t headerSize = 4 + 4 + 4 + 8;
+
+    // the smallest each element can be encoded in, i.e. with empty strings and lists,
+    // so that a broken count is rejected before anything is allocated for it
+    static constexpr size_t minLevelSize = 4 + 4 + 4 + 8 + 4 + 4;
+    static constexpr size_t minSuggestionSize = 4 + 8;
+    static constexpr size_t minValidAnswerSize = 8;
+    static constexpr size_t minClassSize = 4;
+    static constexpr size_t minNodeSize = 4 + 4;
+    static constexpr size_t minChildClassSize = 4;
+    static constexpr size_t minHashedNameSize = 4 + 4;
+} // namespace QuestPoolFormat
+
+class QuestPoolWriter final
+{
+public:
+
+    bool open(const String &path)
+    {
+        this->file.open(path, std::ios::binary | std::ios::trunc);
+        if (!this->file.is_open())
+        {
+            return false;
+        }
+
+        // the header is rewritten in close(), when all offsets are known
+        this->file.write(String(QuestPoolFormat::headerSize, '\0').data(), QuestPoolFormat::headerSize);
+        this->offset = QuestPoolFormat::headerSize;
+        return true;
+    }
+
+    void add(const Quest &quest)
+    {
+        String record;
+        writeU64(record, quest.id);
+
+        writeU32(record, uint32_t(quest.levels.size()));
+        for (const auto &level : quest.levels)
+        {
+            writeString(record, level.hint);
+            writeString(record, level.question);
+            writeU32(record, uint32_t(level.questionClass));
+            writeU64(record, level.questionHash);
+
+            assert(level.suggestions.size() == level.suggestionHashes.size());
+            writeU32(record, uint32_t(level.suggestions.size()));
+            for (int i = 0; i < level.suggestions.size(); ++i)
+            {
+                writeString(record, level.suggestions[i]);
+                writeU64(record, level.suggestionHashes[i]);
+            }
+
+            // sorted, so that the same quests always make the same file
+            Vector<uint64_t> validAnswerHashes(level.validAnswerHashes.begin(), level.validAnswerHashes.end());
+            std::sort(validAnswerHashes.begin(), validAnswerHashes.end());
+            writeU32(record, uint32_t(validAnswerHashes.size()));
+            for (const auto hash : validAnswerHashes)
+            {
+                writeU64(record, hash);
+            }
+        }
+
+        writeU32(record, uint32_t(quest.classes.size()));
+        for (const auto &questClass : quest.classes)
+        {
+            writeU32(record, uint32_t(questClass.nodes.size()));
+            for (const auto &node : questClass.nodes)
+            {
+                writeString(record, node.name);
+                writeU32(record, uint32_t(node.childrenClasses.size()));
+                for (const auto childClass : node.childrenClasses)
+                {
+                    writeU32(record, uint32_t(childClass));
+                }
+            }
+        }
+
+        const SortedMap<Symbol, Symbol> hashedNames(quest.hashedNames.begin(), quest.hashedNames.end());
+        writeU32(record, uint32_t(hashedNames.size()));
+        for (const auto &it : hashedNames)
+        {
+            writeString(record, it.first);
+            writeString(record, it.second);
+        }
+
+        this->questOffsets.push_back(this->offset);
+        this->file.write(record.data(), record.size());
+        this->offset += record.size();
+    }
+
+    bool close()
+    {
+        String offsetsTable;
+        for (const auto questOffset : this->questOffsets)
+        {
+            writeU64(offsetsTable, questOffset);
+        }
+
+        this->file.write(offsetsTable.data(), offsetsTable.size());
+
+        String header(QuestPoolFormat::magic, sizeof(QuestPoolFormat::magic));
+        writeU32(header, QuestPoolFormat::version);
+        writeU32(header, uint32_t(this->questOffsets.size()));
+        writeU64(header, this->offset);
+        assert(header.size() == QuestPoolFormat::headerSize);
+
+        this->file.seekp(0);
+        this->file.write(header.data(), header.size());
+        this->file.close();
+        return !this->file.fail();
+    }
+
+private:
+
+    static void writeU32(String &out, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            out += char((value >> (i * 8)) & 0xff);
+        }
+    }
+
+    static void writeU64(String &out, uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            out += char((value >> (i * 8)) & 0xff);
+        }
+    }
+
+    static void writeString(String &out, const String &value)
+    {
+        writeU32(out, uint32_t(value.size()));
+        out += value;
+    }
+
+    std::ofstream file;
+    uint64_t offset = 0;
+    Vector<uint64_t> questOffsets;
+};
+
+class QuestPool final
+{
+public:
+
+    QuestPool() = default;
+    QuestPool(const QuestPool &) = delete;
+    QuestPool &operator=(const QuestPool &) = delete;
+
+    ~QuestPool()
+    {
+        this->close();
+    }
+
+    bool open(const String &path)
+    {
+        this->close();
+
+#if QUEST_POOL_MMAP
+
+        const auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat fileStats;
+        if (::fstat(fd, &fileStats) != 0 || fileStats.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        auto *mapped = ::mmap(nullptr, size_t(fileStats.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (mapped == MAP_FAILED)
+        {
+            return false;
+        }
+
+        this->data = static_cast<const char *>(mapped);
+        this->size = size_t(fileStats.st_size);
+
+#else
+
+        // no mmap here, so just read it all at once
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        this->buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        this->data = this->buffer.data();
+        this->size = this->buffer.size();
+
+#endif
+
+        Reader header(this->data, this->size, 0);
+        const auto hasMagic = this->size >= QuestPoolFormat::headerSize &&
+            std::memcmp(this->data, QuestPoolFormat::magic, sizeof(QuestPoolFormat::magic)) == 0;
+
+        header.skip(sizeof(QuestPoolFormat::magic));
+        const auto version = header.readU32();
+        this->numQuests = header.readU32();
+        this->offsetsTableOffset = header.readU64();
+
+        if (!hasMagic || header.failed || version != QuestPoolFormat::version ||
+            this->offsetsTableOffset > this->size ||
+            this->numQuests > (this->size - this->offsetsTableOffset) / 8)
+        {
+            this->close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+#if QUEST_POOL_MMAP
+        if (this->data != nullptr)
+        {
+            ::munmap(const_cast<char *>(this->data), this->size);
+        }
+#else
+        this->buffer = {};
+#endif
+
+        this->data = nullptr;
+        this->size = 0;
+        this->numQuests = 0;
+        this->offsetsTableOffset = 0;
+    }
+
+    int getNumQuests() const noexcept
+    {
+        return int(this->numQuests);
+    }
+
+    // returns nothing if the record is truncated or otherwise broken
+    Optional<Quest> load(int index) const
+    {
+        assert(index >= 0 && index < this->getNumQuests());
+
+        Reader offsets(this->data, this->size, this->offsetsTableOffset + uint64_t(index) * 8);
+        Reader reader(this->data, this->size, offsets.readU64());
+
+        Quest quest;
+        quest.id = reader.readU64();
+
+        quest.levels.resize(reader.readCount(QuestPoolFormat::minLevelSize));
+        for (auto &level : quest.levels)
+        {
+            level.hint = reader.readString();
+            level.question = reader.readString();
+            level.questionClass = int(reader.readU32());
+            level.questionHash = reader.readU64();
+
+            level.suggestions.resize(reader.readCount(QuestPoolFormat::minSuggestionSize));
+            level.suggestionHashes.resize(level.suggestions.size());
+            for (int i = 0; i < level.suggestions.size(); ++i)
+            {
+                level.suggestions[i] = reader.readString();
+                level.suggestionHashes[i] = reader.readU64();
+            }
+
+            const auto numValidAnswers = reader.readCount(QuestPoolFormat::minValidAnswerSize);
+            level.validAnswerHashes.reserve(numValidAnswers);
+            for (size_t i = 0; i < numValidAnswers; ++i)
+            {
+                level.validAnswerHashes.insert(reader.readU64());
+            }
+        }
+
+        quest.classes.resize(reader.readCount(QuestPoolFormat::minClassSize));
+        for (auto &questClass : quest.classes)
+        {
+            questClass.nodes.resize(reader.readCount(QuestPoolFormat::minNodeSize));
+            for (auto &node : questClass.nodes)
+            {
+                node.name = reader.readString();
+                node.childrenClasses.resize(reader.readCount(QuestPoolFormat::minChildClassSize));
+                for (auto &childClass : node.childrenClasses)
+                {
+                    childClass = int(reader.readU32());
+                    reader.failed = reader.failed || childClass >= quest.classes.size();
+                }
+            }
+        }
+
+        const auto numHashedNames = reader.readCount(QuestPoolFormat::minHashedNameSize);
+        for (size_t i = 0; i < numHashedNames && !reader.failed; ++i)
+        {
+            auto name = reader.readString();
+            quest.hashedNames[move(name)] = reader.readString();
+        }
+
+        for (const auto &level : quest.levels)
+        {
+            reader.failed = reader.failed ||
+                level.questionClass >= quest.classes.size();
+        }
+
+        if (offsets.failed || reader.failed)
+        {
+            return {};
+        }
+
+        return quest;
+    }
+
+    Optional<Quest> loadRandom(Random &random) const
+    {
+        if (this->numQuests == 0)
+        {
+            return {};
+        }
+
+        return this->load(random.getRandomInt(0, this->getNumQuests() - 1));
+    }
+
+private:
+
+    // bounds-checked little-endian decoding, which never reads past the end,
+    // but sets the failed flag instead and returns zeros
+    struct Reader final
+    {
+        Reader(const char *data, size_t size, uint64_t offset) :
+            data(data), size(size), offset(offset) {}
+
+        const char *data;
+        const size_t size;
+        uint64_t offset;
+        bool failed = false;
+
+        bool skip(uint64_t numBytes)
+        {
+            // written so that a huge offset read from a broken file can't wrap around
+            if (this->failed || this->offset > this->size || numBytes > this->size - this->offset)
+            {
+                this->failed = true;
+                return false;
+            }
+
+            this->offset += numBytes;
+            return true;
+        }
+
+        uint64_t readBytes(int numBytes)
+        {
+            const auto begin = this->offset;
+            if (!this->skip(numBytes))
+            {
+                return 0;
+            }
+
+            uint64_t result = 0;
+            for (int i = 0; i < numBytes; ++i)
+            {
+                result |= uint64_t(uint8_t(this->data[begin + i])) << (i * 8);
+            }
+            return result;
+        }
+
+        uint32_t readU32()
+        {
+            return uint32_t(this->readBytes(4));
+        }
+
+        uint64_t readU64()
+        {
+            return this->readBytes(8);
+        }
+
+        // a number of elements, each of which takes at least the given number of bytes,
+        // so any count that can't fit into the rest of the data is broken
+        size_t readCount(size_t minElementSize)
+        {
+            const auto count = this->readU32();
+            if (this->failed || count > (this->size - this->offset) / minElementSize)
+            {
+                this->failed = true;
+                return 0;
+            }
+
+            return count;
+        }
+
+        String readString()
+        {
+            const auto length = this->readCount(1);
+            const auto begin = this->offset;
+            if (!this->skip(length))
+            {
+                return {};
+            }
+
+            return String(this->data + begin, length);
+        }
+    };
+
+    const char *data = nullptr;
+    size_t size = 0;
+
+    uint32_t numQuests = 0;
+    uint64_t offsetsTableOffset = 0;
+
+#if !QUEST_POOL_MMAP
+    Vector<char> buffer;
+#endif
+};
@@ -0,0 +1,875 @@
+
+#include "Common.h"
+#include "Game.h"
+#include "Json.h"
+#include "Quest.h"
+#include "QuestGenerator.h"
+#include "QuestSkeletonCache.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// A server for many games at once, to host the game ourselves:
+// line-delimited JSON over a localhost TCP socket, a response line for each request line;
+//   {"command":"newGame"}
+//     -> {"session":"S","quest":"Q","level":0,"hints":[...],"question":"...","suggestions":[...]}
+//   {"command":"answer","session":"S","suggestion":N} or {"command":"answer","session":"S","answer":"..."}
+//     -> {"passed":true,"validSuggestions":[...],"level":1,...} or {"passed":false,"ended":true,"win":false}
+//   {"command":"stats"}
+//     -> the latencies of both commands, measured from reading the request to sending the response
+// the requests are handled on a pool of workers, so the responses to pipelined requests
+// may come in any order; any "id" in a request is copied into its response to match them;
+// the quests are generated in the background ahead of time, so starting a game
+// is just taking one out of the warm pool;
+// the sessions are limited in number and expire after a while of inactivity,
+// the request lines are limited in length, and so are the requests waiting for the workers,
+// both per connection and overall, so a client can't run it out of memory;
+// a client that doesn't read its responses is disconnected after a while, never blocking the workers;
+// usage: server [--port P] [--workers W] [--generators G] [--warm N] [--skeletons K] [--sessions S]
+
+// one game session, driven by the requests instead of the UI: the callbacks
+// collect the fields of the response to the request that has triggered them
+class ServerGame final : public Game
+{
+public:
+
+    void onStartGame() override {}
+
+    void onStartLevel(int levelNumber, const Vector<String> &hints,
+        const String &question, const Vector<String> &suggestions) override
+    {
+        this->responseFields.push_back("\"level\":" + std::to_string(levelNumber));
+        this->responseFields.push_back("\"hints\":" + formatJsonArray(hints));
+        this->responseFields.push_back("\"question\":\"" + escapeJson(question) + "\"");
+        this->responseFields.push_back("\"suggestions\":" + formatJsonArray(suggestions));
+        this->numSuggestions = int(suggestions.size());
+    }
+
+    void onEndLevel(bool passed, const Vector<bool> &answerIndices) override
+    {
+        this->responseFields.push_back(String("\"passed\":") + (passed ? "true" : "false"));
+
+        if (!answerIndices.empty())
+        {
+            String validSuggestions = "[";
+            for (int i = 0; i < answerIndices.size(); ++i)
+            {
+                validSuggestions += (i > 0 ? "," : "") + String(answerIndices[i] ? "true" : "false");
+            }
+            this->responseFields.push_back("\"validSuggestions\":" + validSuggestions + "]");
+        }
+    }
+
+    void onEndGame(bool win) override
+    {
+        this->ended = true;
+        this->responseFields.push_back("\"ended\":true");
+        this->responseFields.push_back(String("\"win\":") + (win ? "true" : "false"));
+    }
+
+    Vector<String> start(Quest quest)
+    {
+        this->responseFields.clear();
+        Game::start(move(quest));
+        return move(this->responseFields);
+    }
+
+    template <typename T>
+    Vector<String> answer(const T &answer)
+    {
+        this->responseFields.clear();
+        this->validateAnswer(answer);
+        return move(this->responseFields);
+    }
+
+    int getNumSuggestions() const noexcept
+    {
+        return this->numSuggestions;
+    }
+
+    bool hasEnded() const noexcept
+    {
+        return this->ended;
+    }
+
+    // one request at a time, in case a client sends several for the same session
+    std::mutex mutex;
+
+    std::chrono::steady_clock::time_point lastUsedTime = std::chrono::steady_clock::now();
+
+private:
+
+    Vector<String> responseFields;
+
+    int numSuggestions = 0;
+
+    bool ended = false;
+};
+
+// keeps a number of quests ready to be played, generating more on its own threads
+// as soon as any are taken; if it's ever empty, the quest is generated on the spot
+class WarmQuestPool final
+{
+public:
+
+    WarmQuestPool(int capacity, int numThreads, int numSkeletons) :
+        capacity(std::max(1, capacity)), skeletonCache(numSkeletons), usesSkeletons(numSkeletons > 0)
+    {
+        for (int i = 0; i < numThreads; ++i)
+        {
+            this->generators.emplace_back([this]() { this->runGenerator(); });
+        }
+    }
+
+    ~WarmQuestPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->isStopping = true;
+        }
+
+        this->notFull.notify_all();
+        for (auto &generator : this->generators)
+        {
+            generator.join();
+        }
+    }
+
+    Quest take()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (!this->quests.empty())
+            {
+                auto quest = move(this->quests.front());
+                this->quests.pop_front();
+                this->notFull.notify_one();
+                return quest;
+            }
+        }
+
+        return this->generate();
+    }
+
+private:
+
+    void runGenerator()
+    {
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->notFull.wait(lock, [this]()
+                {
+                    return this->isStopping || this->quests.size() < this->capacity;
+                });
+
+                if (this->isStopping)
+                {
+                    return;
+                }
+            }
+
+            auto quest = this->generate();
+
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->quests.push_back(move(quest));
+        }
+    }
+
+    Quest generate()
+    {
+        const auto questId = Random::makeRandomSeed();
+        if (this->usesSkeletons)
+        {
+            return this->skeletonCache.generate(questId);
+        }
+
+        e::Graph eGraph;
+        Vector<Level> levels;
+        QuestGenerator::generate(questId, eGraph, levels);
+        return Quest::fromGenerated(questId, eGraph, levels);
+    }
+
+    const size_t capacity;
+
+    QuestSkeletonCache skeletonCache;
+    const bool usesSkeletons;
+
+    std::deque<Quest> quests;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    bool isStopping = false;
+
+    Vector<std::thread> generators;
+};
+
+class WorkerPool final
+{
+public:
+
+    using Task = std::function<void()>;
+
+    explicit WorkerPool(int numThreads)
+    {
+        for (int i = 0; i < std::max(1, numThreads); ++i)
+        {
+            this->workers.emplace_back([this]() { this->runWorker(); });
+        }
+    }
+
+    // finishes all the tasks already added
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->isStopping = true;
+        }
+
+        this->hasTasks.notify_all();
+        for (auto &worker : this->workers)
+        {
+            worker.join();
+        }
+    }
+
+    void add(Task task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->tasks.push_back(move(task));
+        }
+
+        this->hasTasks.notify_one();
+    }
+
+private:
+
+    void runWorker()
+    {
+        while (true)
+        {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->hasTasks.wait(lock, [this]() { return this->isStopping || !this->tasks.empty(); });
+                if (this->tasks.empty())
+                {
+                    return;
+                }
+
+                task = move(this->tasks.front());
+                this->tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+
+    std::deque<Task> tasks;
+    std::mutex mutex;
+    std::condition_variable hasTasks;
+    bool isStopping = false;
+
+    Vector<std::thread> workers;
+};
+
+// the percentiles of the recent requests: only the last maxSamples are kept,
+// so that the numbers follow the current load, and the memory stays bounded
+class LatencyStats final
+{
+public:
+
+    void add(double microseconds)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->samples.size() < LatencyStats::maxSamples)
+        {
+            this->samples.push_back(microseconds);
+        }
+        else
+        {
+            this->samples[this->numRequests % LatencyStats::maxSamples] = microseconds;
+        }
+
+        this->numRequests++;
+    }
+
+    String toJson() const
+    {
+        Vector<double> sorted;
+        uint64_t numRequests = 0;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            sorted = this->samples;
+            numRequests = this->numRequests;
+        }
+
+        std::sort(sorted.begin(), sorted.end());
+
+        const auto getPercentile = [&sorted](double fraction)
+        {
+            return sorted.empty() ? 0.0 : sorted[size_t(fraction * (sorted.size() - 1) + 0.5)];
+        };
+
+        return "{\"numRequests\":" + std::to_string(numRequests) +
+            ",\"p50us\":" + std::to_string(getPercentile(0.5)) +
+            ",\"p90us\":" + std::to_string(getPercentile(0.9)) +
+            ",\"p99us\":" + std::to_string(getPercentile(0.99)) +
+            ",\"maxUs\":" + std::to_string(sorted.empty() ? 0.0 : sorted.back()) + "}";
+    }
+
+private:
+
+    static constexpr size_t maxSamples = 10000;
+
+    Vector<double> samples;
+    uint64_t numRequests = 0;
+    mutable std::mutex mutex;
+};
+
+// the socket is closed when both the reading loop and the workers
+// writing the responses are done with the connection
+class Connection final
+{
+public:
+
+    explicit Connection(int socket) :
+        socket(socket) {}
+
+    ~Connection()
+    {
+        ::close(this->socket);
+    }
+
+    // never blocks the worker: whatever the socket can't take right away
+    // is kept, and sent by the reading loop as soon as the socket is ready
+    void send(const String &line)
+    {
+        std::lock_guard<std::mutex> lock(this->outputMutex);
+        if (this->isClosed)
+        {
+            return;
+        }
+
+        if (this->output.empty())
+        {
+            this->lastSentTime = std::chrono::steady_clock::now();
+        }
+
+        this->output += line;
+        this->output += '\n';
+        this->sendOutput();
+    }
+
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock(this->outputMutex);
+        this->sendOutput();
+    }
+
+    bool hasOutput() const
+    {
+        std::lock_guard<std::mutex> lock(this->outputMutex);
+        return !this->output.empty();
+    }
+
+    // the client has stopped reading the responses
+    bool isStalled(std::chrono::steady_clock::time_point now) const
+    {
+        std::lock_guard<std::mutex> lock(this->outputMutex);
+        return !this->output.empty() && now - this->lastSentTime > Connection::sendTimeout;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(this->outputMutex);
+        this->isClosed = true;
+        this->output.clear();
+    }
+
+    const int socket;
+
+    // the lines read so far, and not yet handed to the workers
+    String input;
+    bool isInputEnded = false;
+
+    // the requests handed to the workers, and not yet responded to
+    std::atomic<int> numPendingRequests {0};
+
+    std::atomic<bool> isClosed {false};
+
+private:
+
+    void sendOutput()
+    {
+        size_t offset = 0;
+        while (offset < this->output.size())
+        {
+            const auto numWritten = ::send(this->socket, this->output.data() + offset,
+                this->output.size() - offset, MSG_DONTWAIT);
+
+            if (numWritten > 0)
+            {
+                offset += size_t(numWritten);
+            }
+            else if (numWritten < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            {
+                break;
+            }
+            else
+            {
+                // the client is gone, the reading loop will drop the connection
+                this->isClosed = true;
+                this->output.clear();
+                return;
+            }
+        }
+
+        if (offset > 0)
+        {
+            this->output.erase(0, offset);
+            this->lastSentTime = std::chrono::steady_clock::now();
+        }
+    }
+
+    static constexpr auto sendTimeout = std::chrono::seconds(10);
+
+    String output;
+    std::chrono::steady_clock::time_point lastSentTime;
+    mutable std::mutex outputMutex;
+};
+
+class QuestServer final
+{
+public:
+
+    QuestServer(int numWorkers, int numGenerators, int numWarmQuests, int numSkeletons, int maxNumSessions) :
+        maxNumSessions(size_t(std::max(1, maxNumSessions))),
+        warmQuests(numWarmQuests, numGenerators, numSkeletons), workers(numWorkers) {}
+
+    // longer ones are not requests, the connection is dropped
+    static constexpr size_t maxLineLength = 64 * 1024;
+
+    // the reading loop stops reading from a connection while it has
+    // too many requests waiting for the workers, or while all of them do,
+    // and while its client isn't reading the responses already sent
+    bool canHandle(const Connection &connection) const
+    {
+        return connection.numPendingRequests < QuestServer::maxPendingRequestsPerConnection &&
+            this->numPendingRequests < QuestServer::maxPendingRequests && !connection.hasOutput();
+    }
+
+    void handle(const std::shared_ptr<Connection> &connection, const String &line,
+        std::chrono::steady_clock::time_point receivedTime)
+    {
+        connection->numPendingRequests++;
+        this->numPendingRequests++;
+
+        this->workers.add([this, connection, line, receivedTime]()
+        {
+            const auto request = parseJsonObject(line);
+            const auto command = (request.has_value() && contains(*request, "command")) ?
+                request->at("command") : String();
+
+            auto responseFields = this->handle(command, request);
+            if (request.has_value() && contains(*request, "id"))
+            {
+                responseFields.push_back("\"id\":\"" + escapeJson(request->at("id")) + "\"");
+            }
+
+            String response = "{";
+            for (int i = 0; i < responseFields.size(); ++i)
+            {
+                response += (i > 0 ? "," : "") + responseFields[i];
+            }
+
+            connection->send(response + "}");
+
+            connection->numPendingRequests--;
+            this->numPendingRequests--;
+
+            const std::chrono::duration<double, std::micro> latency =
+                std::chrono::steady_clock::now() - receivedTime;
+            if (command == "newGame")
+            {
+                this->newGameLatency.add(latency.count());
+            }
+            else if (command == "answer")
+            {
+                this->answerLatency.add(latency.count());
+            }
+        });
+    }
+
+    // the abandoned sessions would otherwise stay forever
+    void removeIdleSessions()
+    {
+        const auto now = std::chrono::steady_clock::now();
+
+        std::lock_guard<std::mutex> lock(this->sessionsMutex);
+        for (auto it = this->sessions.begin(); it != this->sessions.end();)
+        {
+            std::unique_lock<std::mutex> gameLock(it->second->mutex, std::try_to_lock);
+            if (gameLock.owns_lock() && now - it->second->lastUsedTime > QuestServer::sessionTimeout)
+            {
+                gameLock.unlock();
+                it = this->sessions.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    String getStats() const
+    {
+        return "{\"newGame\":" + this->newGameLatency.toJson() +
+            ",\"answer\":" + this->answerLatency.toJson() + "}";
+    }
+
+private:
+
+    static Vector<String> makeError(const String &message)
+    {
+        return {"\"error\":\"" + escapeJson(message) + "\""};
+    }
+
+    Vector<String> handle(const String &command, const Optional<HashMap<String, String>> &request)
+    {
+        if (!request.has_value())
+        {
+            return QuestServer::makeError("Malformed request");
+        }
+
+        if (command == "newGame")
+        {
+            if (this->getNumSessions() >= this->maxNumSessions)
+            {
+                return QuestServer::makeError("Too many sessions");
+            }
+
+            auto game = std::make_shared<ServerGame>();
+            std::lock_guard<std::mutex> gameLock(game->mutex);
+
+            auto responseFields = game->start(this->warmQuests.take());
+            responseFields.push_back("\"quest\":\"" + std::to_string(game->getQuestId()) + "\"");
+
+            if (!game->hasEnded())
+            {
+                std::lock_guard<std::mutex> lock(this->sessionsMutex);
+
+                // checked again, since other workers may have started games meanwhile
+                if (this->sessions.size() >= this->maxNumSessions)
+                {
+                    return QuestServer::makeError("Too many sessions");
+                }
+
+                auto sessionId = QuestServer::makeSessionId();
+                while (contains(this->sessions, sessionId))
+                {
+                    sessionId = QuestServer::makeSessionId();
+                }
+
+                this->sessions[sessionId] = game;
+                responseFields.push_back("\"session\":\"" + sessionId + "\"");
+            }
+
+            return responseFields;
+        }
+
+        if (command == "answer")
+        {
+            const auto sessionId = contains(*request, "session") ? request->at("session") : String();
+
+            std::shared_ptr<ServerGame> game;
+            {
+                std::lock_guard<std::mutex> lock(this->sessionsMutex);
+                const auto found = this->sessions.find(sessionId);
+                if (found == this->sessions.end())
+                {
+                    return QuestServer::makeError("Unknown session");
+                }
+
+                game = found->second;
+            }
+
+            std::lock_guard<std::mutex> gameLock(game->mutex);
+            if (game->hasEnded())
+            {
+                return QuestServer::makeError("The game has ended");
+            }
+
+            game->lastUsedTime = std::chrono::steady_clock::now();
+
+            Vector<String> responseFields;
+            if (contains(*request, "suggestion"))
+            {
+                int suggestionIndex = -1;
+                try
+                {
+                    suggestionIndex = std::stoi(request->at("suggestion"));
+                }
+                catch (...) {}
+
+                if (suggestionIndex < 0 || suggestionIndex >= game->getNumSuggestions())
+                {
+                    return QuestServer::makeError("No such suggestion");
+                }
+
+                responseFields = game->answer(suggestionIndex);
+            }
+            else if (contains(*request, "answer"))
+            {
+                responseFields = game->answer(request->at("answer"));
+            }
+            else
+            {
+                return QuestServer::makeError("No answer");
+            }
+
+            if (game->hasEnded())
+            {
+                std::lock_guard<std::mutex> lock(this->sessionsMutex);
+                this->sessions.erase(sessionId);
+            }
+
+            return responseFields;
+        }
+
+        if (command == "stats")
+        {
+            return {"\"stats\":" + this->getStats()};
+        }
+
+        return QuestServer::makeError("Unknown command");
+    }
+
+    size_t getNumSessions()
+    {
+        std::lock_guard<std::mutex> lock(this->sessionsMutex);
+        return this->sessions.size();
+    }
+
+    // 128 random bits, so that a client can't guess the sessions of the others
+    static String makeSessionId()
+    {
+        static const char *hexDigits = "0123456789abcdef";
+
+        String result;
+        for (int i = 0; i < 2; ++i)
+        {
+            const auto value = Random::makeRandomSeed();
+            for (int shift = 60; shift >= 0; shift -= 4)
+            {
+                result += hexDigits[(value >> shift) & 0xf];
+            }
+        }
+
+        return result;
+    }
+
+    static constexpr auto sessionTimeout = std::chrono::minutes(30);
+
+    static constexpr int maxPendingRequestsPerConnection = 32;
+    static constexpr int maxPendingRequests = 1024;
+
+    std::atomic<int> numPendingRequests {0};
+
+    const size_t maxNumSessions;
+
+    WarmQuestPool warmQuests;
+
+    HashMap<String, std::shared_ptr<ServerGame>> sessions;
+    std::mutex sessionsMutex;
+
+    LatencyStats newGameLatency;
+    LatencyStats answerLatency;
+
+    // the last member, so that its destructor finishes the tasks while the rest is still there
+    WorkerPool workers;
+};
+
+static std::atomic<bool> shouldStop {false};
+
+int main(int argc, char **argv)
+{
+    HashMap<String, String> options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        options[argv[i]] = argv[i + 1];
+    }
+
+    const auto getOption = [&options](const String &name, int defaultValue)
+    {
+        return contains(options, name) ? std::stoi(options.at(name)) : defaultValue;
+    };
+
+    const auto port = getOption("--port", 7777);
+    const auto numWorkers = getOption("--workers", int(std::thread::hardware_concurrency()));
+    const auto numGenerators = getOption("--generators", 1);
+    const auto numWarmQuests = getOption("--warm", 64);
+    const auto numSkeletons = getOption("--skeletons", 0);
+    const auto maxNumSessions = getOption("--sessions", 100000);
+
+    const auto listeningSocket = ::socket(AF_INET, SOCK_STREAM, 0);
+    const int reuseAddress = 1;
+    ::setsockopt(listeningSocket, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+
+    // only for the local clients, e.g. a reverse proxy in front of it
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(uint16_t(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (listeningSocket < 0 ||
+        ::bind(listeningSocket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        ::listen(listeningSocket, SOMAXCONN) != 0)
+    {
+        std::cerr << "Cannot listen on port " << port << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, [](int) { shouldStop = true; });
+    std::signal(SIGTERM, [](int) { shouldStop = true; });
+
+    std::cerr << "Listening on 127.0.0.1:" << port << std::endl;
+
+    QuestServer server(numWorkers, numGenerators, numWarmQuests, numSkeletons, maxNumSessions);
+
+    // a single thread does all the reading, the workers do all the rest
+    Vector<std::shared_ptr<Connection>> connections;
+    auto lastCleanupTime = std::chrono::steady_clock::now();
+
+    while (!shouldStop)
+    {
+        // the connections with too many requests waiting are not read from,
+        // until the workers catch up, so the client's sends block instead
+        Vector<pollfd> pollFds;
+        pollFds.push_back({listeningSocket, POLLIN, 0});
+        for (const auto &connection : connections)
+        {
+            const auto canRead = !connection->isInputEnded && server.canHandle(*connection) &&
+                connection->input.find('\n') == String::npos;
+            pollFds.push_back({connection->socket,
+                short((canRead ? POLLIN : 0) | (connection->hasOutput() ? POLLOUT : 0)), 0});
+        }
+
+        // wakes up now and then to check if it should stop,
+        // and to hand the workers the requests they had no room for
+        if (::poll(pollFds.data(), pollFds.size(), 100) < 0)
+        {
+            continue;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+
+        Vector<std::shared_ptr<Connection>> openConnections;
+        for (int i = 0; i < connections.size(); ++i)
+        {
+            const auto &pollFd = pollFds[i + 1];
+            auto &connection = connections[i];
+            if (connection->isClosed || (pollFd.revents & (POLLHUP | POLLERR)) != 0 || connection->isStalled(now))
+            {
+                connection->close();
+                continue; // closed, once the workers are done with it
+            }
+
+            if ((pollFd.revents & POLLOUT) != 0)
+            {
+                connection->flush();
+            }
+
+            auto &input = connection->input;
+            if ((pollFd.revents & POLLIN) != 0)
+            {
+                char buffer[4096];
+                const auto numRead = ::recv(pollFd.fd, buffer, sizeof(buffer), 0);
+                if (numRead < 0)
+                {
+                    connection->close();
+                    continue; // closed, once the workers are done with it
+                }
+
+                if (numRead == 0)
+                {
+                    connection->isInputEnded = true;
+                }
+
+                input.append(buffer, size_t(numRead));
+            }
+
+            size_t lineEnd = 0;
+            while (server.canHandle(*connection) && (lineEnd = input.find('\n')) != String::npos)
+            {
+                auto line = input.substr(0, lineEnd);
+                input.erase(0, lineEnd + 1);
+                if (!line.empty() && line.back() == '\r')
+                {
+                    line.pop_back();
+                }
+
+                if (!line.empty())
+                {
+                    server.handle(connection, line, now);
+                }
+            }
+
+            const auto lastLineEnd = input.rfind('\n');
+            const auto incompleteLineLength = input.size() - (lastLineEnd == String::npos ? 0 : lastLineEnd + 1);
+            if (incompleteLineLength > QuestServer::maxLineLength)
+            {
+                connection->close();
+                continue; // closed, once the workers are done with it
+            }
+
+            // once the client has sent all its requests, it's kept until it gets all the responses
+            const auto isDone = connection->isInputEnded && connection->numPendingRequests == 0 &&
+                !connection->hasOutput() && lastLineEnd == String::npos;
+            if (isDone)
+            {
+                continue; // closed, once the workers are done with it
+            }
+
+            openConnections.push_back(connection);
+        }
+
+        connections = move(openConnections);
+
+        if (pollFds.front().revents & POLLIN)
+        {
+            const auto socket = ::accept(listeningSocket, nullptr, nullptr);
+            if (socket >= 0)
+            {
+                connections.push_back(std::make_shared<Connection>(socket));
+            }
+        }
+
+        if (now - lastCleanupTime > std::chrono::minutes(1))
+        {
+            server.removeIdleSessions();
+            lastCleanupTime = now;
+        }
+    }
+
+    ::close(listeningSocket);
+    std::cerr << server.getStats() << std::endl;
+    return 0;
+}
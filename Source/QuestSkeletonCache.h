@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Common.h"
+#include "Random.h"
+#include "Alphabet.h"
+#include "QuestGenerator.h"
+#include "Quest.h"
+#include "GenerationStats.h"
+#include "EGraph.h"
+
+#if !WEB_CLIENT
+#include <mutex>
+#endif
+
+// The structure of a quest only depends on the properties picked for its levels
+// and on how buildEGraph wires the terms together, not on which symbols it picks,
+// so a quest can be made to look new just by renaming its symbols; this cache keeps
+// one generated quest (a skeleton) for each combination of properties,
+// and once it has enough of them, makes all the new quests by renaming those,
+// which takes a fraction of the time of saturating and extracting hints;
+// the renamed quests can't be reproduced by their ids, so this is meant
+// for filling the quest pools, not for the quests started by id
+
+class QuestSkeletonCache final
+{
+public:
+
+    explicit QuestSkeletonCache(int maxNumSkeletons) :
+        maxNumSkeletons(maxNumSkeletons) {}
+
+    // either generates the quest and maybe keeps it as a skeleton,
+    // or renames the symbols in one of the skeletons, when the cache is full;
+    // safe to call from several threads at once
+    Quest generate(QuestId questId, GenerationStats *outStats = nullptr,
+        PropertyStats *propertyStats = nullptr)
+    {
+        Random random(questId);
+
+        Optional<Quest> skeleton;
+        {
+#if !WEB_CLIENT
+            std::lock_guard<std::mutex> lock(this->mutex);
+#endif
+            if (this->skeletons.size() >= this->maxNumSkeletons && !this->skeletons.empty())
+            {
+                skeleton = this->skeletons[random.getRandomIndex(this->skeletons.size())];
+            }
+        }
+
+        if (skeleton.has_value())
+        {
+            skeleton->id = questId;
+            QuestSkeletonCache::relabel(*skeleton, random);
+            return move(*skeleton);
+        }
+
+        // the stats tell which properties the quest has been made with
+        e::Graph eGraph;
+        Vector<Level> levels;
+        GenerationStats stats;
+        auto *generationStats = (outStats != nullptr) ? outStats : &stats;
+        QuestGenerator::generate(questId, eGraph, levels, generationStats, propertyStats);
+        const auto propertyIndices = generationStats->propertyIndices;
+
+        auto quest = Quest::fromGenerated(questId, eGraph, levels);
+
+        {
+#if !WEB_CLIENT
+            std::lock_guard<std::mutex> lock(this->mutex);
+#endif
+            if (this->skeletons.size() < this->maxNumSkeletons &&
+                this->skeletonIndices.emplace(propertyIndices, int(this->skeletons.size())).second)
+            {
+                this->skeletons.push_back(quest);
+            }
+        }
+
+        return quest;
+    }
+
+    // picks new symbols the same way the generator does: the terms never collide,
+    // and the operations all come from different groups
+    static void relabel(Quest &quest, Random &random)
+    {
+        const auto &alphabet = Alphabet::getInterner();
+
+        // in the order of appearance, so that the same seed gives the same names
+        Vector<Symbol> terms;
+        Vector<Symbol> operations;
+        HashSet<Symbol> seenSymbols;
+        for (const auto &questClass : quest.classes)
+        {
+            for (const auto &node : questClass.nodes)
+            {
+                if (seenSymbols.insert(node.name).second)
+                {
+                    (node.childrenClasses.empty() ? terms : operations).push_back(node.name);
+                }
+            }
+        }
+
+        HashMap<Symbol, Symbol> newNames;
+
+        auto newTermIds = alphabet.getTermIds();
+        random.shuffle(newTermIds);
+        assert(terms.size() <= newTermIds.size());
+        for (int i = 0; i < terms.size(); ++i)
+        {
+            newNames[terms[i]] = alphabet.getSymbol(newTermIds[i]);
+        }
+
+        HashSet<int> usedOperationGroups;
+        for (const auto &operation : operations)
+        {
+            newNames[operation] = alphabet.getSymbol(random.pickOne(
+                random.pickOneUnique(alphabet.getOperationGroupIds(), usedOperationGroups)));
+        }
+
+        quest.renameSymbols(newNames);
+    }
+
+    int getNumSkeletons() const
+    {
+#if !WEB_CLIENT
+        std::lock_guard<std::mutex> lock(this->mutex);
+#endif
+        return int(this->skeletons.size());
+    }
+
+private:
+
+    const int maxNumSkeletons;
+
+    Vector<Quest> skeletons;
+
+    // one skeleton per combination of properties, as indices in AlienAlgebra::allProperties
+    SortedMap<Vector<int>, int> skeletonIndices;
+
+#if !WEB_CLIENT
+    mutable std::mutex mutex;
+#endif
+};
@@ -1,124 +1,323 @@
 #pragma once
 
 #include "Common.h"
+#include <algorithm>
+#include <cstdint>
 #include <random>
+#include <utility>
 
+// xoshiro256** seeded with splitmix64: much smaller and faster than mt19937,
+// and it gives the same sequences on all platforms, which the standard
+// distributions don't guarantee, so all the bounded numbers
+// are made here too, with Lemire's multiply-and-reject method
 class Random final
 {
 public:
 
-    Random() = default;
+    Random() :
+        Random(Random::makeRandomSeed()) {}
+
+    explicit Random(uint64_t seed)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            this->state[i] = Random::mixSeed(seed, i);
+        }
+    }
+
+    static uint64_t makeRandomSeed()
+    {
+        std::random_device device;
+        return (uint64_t(device()) << 32) | uint64_t(device());
+    }
+
+    // derives independent seeds from a single one (splitmix64 finalizer),
+    // e.g. a seed for each generation attempt from the quest id
+    static uint64_t mixSeed(uint64_t seed, uint64_t stream)
+    {
+        auto z = seed + (stream + 1) * 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t nextSeed()
+    {
+        return this->next();
+    }
 
     bool rollD2()
     {
-        return this->getRandomInt(1, 2) == 1;
+        return this->getRandomIndex(2) == 0;
     }
 
     bool rollD5()
     {
-        return this->getRandomInt(1, 5) == 1;
+        return this->getRandomIndex(5) == 0;
     }
 
     template <typename T>
     void shuffle(Vector<T> &origin)
     {
-        for (unsigned i = 0; i < origin.size() - 1; i++)
+        for (size_t i = 0; i + 1 < origin.size(); i++)
         {
-            const auto randomIndex = this->getRandomInt(i, int(origin.size()) - 1);
+            const auto randomIndex = i + this->getRandomIndex(origin.size() - i);
             std::swap(origin[i], origin[randomIndex]);
         }
     }
 
     template <typename T>
-    T pickOne(const HashSet<T> &origin)
+    T pickOne(const Vector<T> &origin)
     {
         assert(!origin.empty());
-        return *std::next(origin.begin(), this->getRandomInt(0, int(origin.size()) - 1));
+        return origin[this->getRandomIndex(origin.size())];
     }
 
+    // the "unique" picks below skip the used elements instead of retrying,
+    // so they take the same time however many elements are used already
+
     template <typename T>
-    T pickOne(const Vector<T> &origin)
+    T pickOneUnique(const Vector<T> &origin, HashSet<int> &usedIndices)
     {
         assert(!origin.empty());
-        return origin[this->getRandomInt(0, int(origin.size()) - 1)];
+        const auto index = this->pickUnusedIndex(origin.size(),
+            [&](int i) { return contains(usedIndices, i); });
+
+        if (index < 0)
+        {
+            //assert(false); even if this happens, make sure to return something
+            return this->pickOne(origin);
+        }
+
+        usedIndices.insert(index);
+        return origin[index];
     }
 
     template <typename T>
-    T pickOneUnique(const HashSet<T> &origin, HashSet<T> &used)
+    T pickOneUnique(const Vector<T> &origin, HashSet<T> &used)
     {
         assert(!origin.empty());
-        if (origin.size() <= used.size())
+        const auto index = this->pickUnusedIndex(origin.size(),
+            [&](int i) { return contains(used, origin[i]); });
+
+        if (index < 0)
         {
-            //assert(false); even if this happens, make sure to return something
             return this->pickOne(origin);
         }
-        while (true)
+
+        used.insert(origin[index]);
+        return origin[index];
+    }
+
+    // a partial Fisher-Yates shuffle of the unused elements
+    template <typename T>
+    Vector<T> pickUnique(const Vector<T> &origin, HashSet<T> &used, int numElements = 1)
+    {
+        Vector<T> candidates;
+        for (const auto &element : origin)
         {
-            const auto element = this->pickOne(origin);
             if (!contains(used, element))
             {
-                used.insert(element);
-                return element;
+                candidates.push_back(element);
             }
-        };
+        }
+
+        assert(numElements <= candidates.size());
+        numElements = std::min(numElements, int(candidates.size()));
+
+        for (int i = 0; i < numElements; ++i)
+        {
+            const auto randomIndex = i + this->getRandomIndex(candidates.size() - i);
+            std::swap(candidates[i], candidates[randomIndex]);
+            used.insert(candidates[i]);
+        }
+
+        candidates.resize(numElements);
+        return candidates;
     }
 
     template <typename T>
-    T pickOneUnique(const Vector<T> &origin, HashSet<int> &usedIndices)
+    Vector<T> pickUnique(const Vector<T> &origin, const HashSet<T> &used, int numElements = 1)
     {
-        assert(!origin.empty());
-        if (origin.size() <= usedIndices.size())
+        HashSet<T> tempUsed(used);
+        return this->pickUnique(origin, tempUsed, numElements);
+    }
+
+    // an index picked with the probability proportional to its weight
+    int pickWeightedIndex(const Vector<double> &weights)
+    {
+        assert(!weights.empty());
+
+        double totalWeight = 0.0;
+        for (const auto weight : weights)
         {
-            //assert(false); even if this happens, make sure to return something
-            return this->pickOne(origin);
+            totalWeight += weight;
         }
+
+        auto value = this->getRandomDouble() * totalWeight;
+        for (int i = 0; i < weights.size(); ++i)
+        {
+            value -= weights[i];
+            if (value < 0.0)
+            {
+                return i;
+            }
+        }
+
+        // rounding errors
+        return int(weights.size()) - 1;
+    }
+
+    // a uniform number in [0, 1), out of the 53 bits a double can hold
+    double getRandomDouble()
+    {
+        return double(this->next() >> 11) * 0x1.0p-53;
+    }
+
+    int getRandomInt(int min, int max)
+    {
+        assert(min <= max);
+        const auto range = uint64_t(int64_t(max) - int64_t(min)) + 1;
+        return int(int64_t(min) + int64_t(this->getRandomIndex(range)));
+    }
+
+    // a uniform number in [0, size), without the modulo bias
+    uint64_t getRandomIndex(uint64_t size)
+    {
+        assert(size > 0);
+
+        if (size <= (uint64_t(1) << 32))
+        {
+            // Lemire's method: the high half of a 32x32 bit product is
+            // the result, and the low half tells if it falls into the biased part,
+            // which is rare enough to compute the exact threshold only then
+            auto product = (this->next() >> 32) * size;
+            auto low = uint32_t(product);
+            if (low < size)
+            {
+                const auto threshold = uint32_t((uint64_t(1) << 32) % size);
+                while (low < threshold)
+                {
+                    product = (this->next() >> 32) * size;
+                    low = uint32_t(product);
+                }
+            }
+
+            return product >> 32;
+        }
+
+        // never happens in practice, but let's be correct
+        const auto threshold = (0 - size) % size;
         while (true)
         {
-            const auto elementIndex = this->getRandomInt(0, int(origin.size()) - 1);
-            if (!contains(usedIndices, elementIndex))
+            const auto value = this->next();
+            if (value >= threshold)
             {
-                usedIndices.insert(elementIndex);
-                return origin[elementIndex];
+                return value % size;
             }
-        };
+        }
     }
 
-    template <typename T>
-    Vector<T> pickUnique(const Vector<T> &origin, HashSet<T> &used, int numElements = 1)
+private:
+
+    template <typename F>
+    int pickUnusedIndex(size_t size, F &&isUsed)
     {
-        assert(used.size() <= origin.size());
-        assert(numElements <= (origin.size() - used.size()));
+        int numUnused = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            numUnused += int(!isUsed(i));
+        }
 
-        HashSet<T> set;
-        while (set.size() != numElements)
+        if (numUnused == 0)
         {
-            const auto element = origin[this->getRandomInt(0, int(origin.size()) - 1)];
-            if (!contains(used, element))
+            return -1;
+        }
+
+        auto n = int(this->getRandomIndex(numUnused));
+        for (int i = 0; i < size; ++i)
+        {
+            if (!isUsed(i) && n-- == 0)
             {
-                set.insert(element);
-                used.insert(element);
+                return i;
             }
         }
 
-        Vector<T> result;
-        result.insert(result.begin(), set.begin(), set.end());
+        assert(false);
+        return -1;
+    }
+
+    static uint64_t rotateLeft(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t next()
+    {
+        const auto result = Random::rotateLeft(this->state[1] * 5, 7) * 9;
+        const auto t = this->state[1] << 17;
+
+        this->state[2] ^= this->state[0];
+        this->state[3] ^= this->state[1];
+        this->state[1] ^= this->state[2];
+        this->state[0] ^= this->state[3];
+
+        this->state[2] ^= t;
+        this->state[3] = Random::rotateLeft(this->state[3], 45);
+
         return result;
     }
 
-    template <typename T>
-    Vector<T> pickUnique(const Vector<T> &origin, const HashSet<T> &used, int numElements = 1)
+    uint64_t state[4];
+};
+
+// draws elements without repetition in O(1) each: the drawn element
+// is swapped out of the unused part of the vector, which is
+// the Fisher-Yates shuffle done one step at a time; when all elements
+// are used, it just picks any of them, same as Random::pickOneUnique
+template <typename T>
+class UniquePicker final
+{
+public:
+
+    UniquePicker() = default;
+    explicit UniquePicker(const Vector<T> &elements) :
+        elements(elements), numUnused(int(elements.size())) {}
+
+    void add(const T &element)
     {
-        HashSet<T> tempUsed(used);
-        return this->pickUnique(origin, tempUsed, numElements);
+        this->elements.push_back(element);
+        std::swap(this->elements.back(), this->elements[this->numUnused]);
+        this->numUnused++;
     }
 
-    int getRandomInt(int min, int max)
+    bool empty() const noexcept
+    {
+        return this->elements.empty();
+    }
+
+    int getNumPicked() const noexcept
+    {
+        return int(this->elements.size()) - this->numUnused;
+    }
+
+    T pick(Random &random)
     {
-        std::uniform_int_distribution<int> distribution(min, max);
-        return distribution(this->rng);
+        assert(!this->elements.empty());
+        if (this->numUnused == 0)
+        {
+            return random.pickOne(this->elements);
+        }
+
+        const auto index = int(random.getRandomIndex(this->numUnused));
+        this->numUnused--;
+        std::swap(this->elements[index], this->elements[this->numUnused]);
+        return this->elements[this->numUnused];
     }
 
 private:
 
-    std::mt19937 rng = std::mt19937(std::random_device{}());
+    // the unused ones come first
+    Vector<T> elements;
+    int numUnused = 0;
 };